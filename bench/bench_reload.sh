@@ -0,0 +1,58 @@
+#!/bin/sh
+# Hot reloads a shader while rendering headless on llvmpipe, and reports the frame
+# times next to the reload latency. It runs once building the programs on the
+# compile thread and once on the render thread: the reloads should only show up in
+# the frame times of the second run.
+#
+# Run it with `make bench-reload`, or directly:
+#   bench/bench_reload.sh [shloader binary] [resources folder]
+# Needs xvfb-run and Mesa.
+set -eu
+
+BIN=${1:-build/shloader}
+RESOURCES=${2:-resources}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+fail() {
+    echo "FAILED: $*"
+    exit 1
+}
+
+# Renders a copy of the resources and edits the basic shader a few times while it
+# runs. The arguments are passed to shloader.
+run() {
+    rm -rf "$WORK/resources"
+    cp -r "$RESOURCES" "$WORK/resources"
+
+    LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a "$BIN" --resources "$WORK/resources" \
+        --no-shader-cache --exit-after 10 "$@" > "$WORK/log" 2>&1 &
+    PID=$!
+
+    sleep 2
+    for color in 0.2f 0.5f 0.8f; do
+        # Written next to the shader and renamed over it, like editors save.
+        sed "s/vec4([0-9.]*f, 1.0f, 0.3f/vec4($color, 1.0f, 0.3f/" \
+            "$WORK/resources/basic.glsl" > "$WORK/basic.glsl.tmp"
+        mv "$WORK/basic.glsl.tmp" "$WORK/resources/basic.glsl"
+        sleep 2
+    done
+
+    if ! wait "$PID"; then
+        cat "$WORK/log"
+        fail "$BIN exited with an error"
+    fi
+
+    sed -n '/^Hot reload latency/,$p' "$WORK/log"
+    RELOADS=$(awk '$1 == "end" && $2 == "to" { print $4 }' "$WORK/log")
+    if [ "${RELOADS:-0}" -eq 0 ]; then
+        cat "$WORK/log"
+        fail "no reload reached the screen"
+    fi
+}
+
+echo "Compile thread:"
+run
+echo
+echo "Render thread:"
+run --no-compile-thread
@@ -0,0 +1,389 @@
+// Stress benchmark of the watcher. Generates file churn (creates, modifies and
+// renames across nested directories) in a tmpfs, and measures how many events the
+// watcher sustains, their delivery latency, the CPU used by the watcher thread and
+// how many changes were lost or coalesced.
+//
+// Build and run with `make bench-watcher`, arguments go in BENCH_ARGS.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#define LT_IMPLEMENTATION
+#include "lt.h"
+#include "watcher.h"
+#include "metrics.h"
+
+#define MAX_SAMPLES (1 << 20)
+
+typedef struct BenchOptions {
+    isize ops;
+    isize files;
+    i32   depth;
+    i32   fanout;
+    i32   debounce_ms;
+    bool  poll;
+    const char *dir;
+} BenchOptions;
+
+// State of a file of the working set. Files are named after their index, so the
+// consumer can find the file of an event from its name alone.
+typedef struct BenchFile {
+    isize        dir;
+    bool         exists;
+    // Last time the churn touched the file, and last time the consumer got an event
+    // for it.
+    _Atomic u64  changed_ns;
+    _Atomic u64  delivered_ns;
+} BenchFile;
+
+static BenchFile    *g_files      = NULL;
+static isize         g_num_files  = 0;
+static String      **g_dirs       = NULL;
+static isize         g_num_dirs   = 0;
+static atomic_bool   g_consuming  = false;
+// Written by the consumer thread only, read once it is joined.
+static u64          *g_samples    = NULL;
+static isize         g_num_samples = 0;
+static u64           g_num_events = 0;
+static u64           g_num_overflows = 0;
+static WatcherSubscription g_sub  = -1;
+
+u64 bench_now_ns() {
+    return metrics_now_ns();
+}
+
+// CPU time used so far by another thread.
+u64 bench_thread_cpu_ns(pthread_t thread) {
+    clockid_t clock;
+    struct timespec ts;
+
+    if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+// Small xorshift generator, so runs with the same options do the same operations.
+static u64 g_rng = 0x9e3779b97f4a7c15ull;
+
+u64 bench_random(u64 n) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng % n;
+}
+
+void bench_file_path(char *out, isize size, isize file) {
+    snprintf(out, size, "%s/f%ld.glsl", g_dirs[g_files[file].dir]->data, (long)file);
+}
+
+// Returns the index of the file named by an event, or -1 if it is not one of ours.
+isize bench_file_index(const String *name) {
+    const char *base = strrchr(name->data, '/');
+    base = base ? base + 1 : name->data;
+
+    if (base[0] != 'f') {
+        return -1;
+    }
+    char *end;
+    long index = strtol(base + 1, &end, 10);
+    if (end == base + 1 || strcmp(end, ".glsl") != 0 || index < 0 || index >= g_num_files) {
+        return -1;
+    }
+    return (isize)index;
+}
+
+void bench_write_file(const char *path, isize value) {
+    i32 fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0) {
+        LT_FAIL("Could not write %s: %s\n", path, strerror(errno));
+    }
+
+    char contents[64];
+    i32 len = snprintf(contents, sizeof(contents), "// %ld\n", (long)value);
+    isize unused = write(fd, contents, len);
+    LT_UNUSED(unused);
+    close(fd);
+}
+
+// Creates the tree of directories below root, depth levels with fanout children each.
+void bench_make_dirs(const char *root, i32 depth, i32 fanout) {
+    g_dirs[g_num_dirs++] = string_make(root);
+
+    for (isize parent = 0; parent < g_num_dirs; parent++) {
+        // Depth of the parent, counted from the slashes after the root.
+        i32 level = 0;
+        for (const char *c = g_dirs[parent]->data + strlen(root); *c; c++) {
+            level += *c == '/';
+        }
+        if (level >= depth) {
+            continue;
+        }
+
+        for (i32 i = 0; i < fanout; i++) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/d%d", g_dirs[parent]->data, i);
+            if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+                LT_FAIL("Could not create %s: %s\n", path, strerror(errno));
+            }
+            g_dirs[g_num_dirs++] = string_make(path);
+        }
+    }
+}
+
+void *bench_consume(void *arg) {
+    LT_UNUSED(arg);
+    WatcherEvent events[WATCHER_MAX_EVENTS];
+
+    // Keeps going a little after being told to stop, so the queue ends up empty.
+    bool draining = true;
+    while (atomic_load(&g_consuming) || draining) {
+        isize n = watcher_drain(g_sub, events, WATCHER_MAX_EVENTS);
+        u64 now_ns = bench_now_ns();
+        draining = n > 0;
+
+        if (watcher_take_overflow(g_sub)) {
+            g_num_overflows++;
+        }
+
+        for (isize i = 0; i < n; i++) {
+            const WatcherEvent *ev = &events[i];
+            g_num_events++;
+            metrics_record(MetricsStage_Enqueue, ev->enqueue_ns - ev->read_ns);
+            metrics_record(MetricsStage_Dequeue, now_ns - ev->enqueue_ns);
+
+            isize file = bench_file_index(ev->name);
+            if (file < 0) {
+                continue;
+            }
+
+            u64 changed_ns = atomic_load(&g_files[file].changed_ns);
+            if (changed_ns != 0 && changed_ns <= now_ns && g_num_samples < MAX_SAMPLES) {
+                g_samples[g_num_samples++] = now_ns - changed_ns;
+            }
+            atomic_store(&g_files[file].delivered_ns, now_ns);
+        }
+
+        if (n == 0) {
+            // Roughly the pace of a render loop draining once per frame, but faster,
+            // so the consumer is not what limits the benchmark.
+            struct timespec ts = { 0, 500000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+void bench_sleep_ms(u64 ms) {
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {}
+}
+
+i32 compare_u64(const void *a, const void *b) {
+    u64 x = *(const u64 *)a;
+    u64 y = *(const u64 *)b;
+    return (x > y) - (x < y);
+}
+
+u64 bench_percentile(f64 percentile) {
+    if (g_num_samples == 0) {
+        return 0;
+    }
+    isize i = (isize)(percentile * (f64)(g_num_samples - 1) + 0.5);
+    return g_samples[i];
+}
+
+void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "  --ops <n>          Operations to perform (default 20000)\n");
+    fprintf(stderr, "  --files <n>        Files in the working set (default 2000)\n");
+    fprintf(stderr, "  --depth <n>        Levels of nested directories (default 3)\n");
+    fprintf(stderr, "  --fanout <n>       Subdirectories per directory (default 4)\n");
+    fprintf(stderr, "  --debounce <ms>    Watcher debounce window (default %d)\n",
+            WATCHER_DEFAULT_DEBOUNCE_MS);
+    fprintf(stderr, "  --poll             Use the polling backend\n");
+    fprintf(stderr, "  --dir <path>       Where to create the tree (default /dev/shm)\n");
+}
+
+int main(i32 argc, char **argv) {
+    BenchOptions opts = {
+        .ops = 20000,
+        .files = 2000,
+        .depth = 3,
+        .fanout = 4,
+        .debounce_ms = WATCHER_DEFAULT_DEBOUNCE_MS,
+        .poll = false,
+        .dir = "/dev/shm",
+    };
+
+    for (i32 i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--ops") == 0 && has_value) {
+            opts.ops = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--files") == 0 && has_value) {
+            opts.files = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--depth") == 0 && has_value) {
+            opts.depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fanout") == 0 && has_value) {
+            opts.fanout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--debounce") == 0 && has_value) {
+            opts.debounce_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--poll") == 0) {
+            opts.poll = true;
+        } else if (strcmp(argv[i], "--dir") == 0 && has_value) {
+            opts.dir = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.files <= 0 || opts.depth < 0 || opts.fanout <= 0 || opts.depth > 6) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // The tree is made in a tmpfs, so the disk is not what gets measured.
+    char root[PATH_MAX];
+    snprintf(root, sizeof(root), "%s/bench-watcher-XXXXXX", opts.dir);
+    if (mkdtemp(root) == NULL) {
+        LT_FAIL("Could not create a directory in %s: %s\n", opts.dir, strerror(errno));
+    }
+
+    isize max_dirs = 1;
+    for (i32 level = 0, width = 1; level < opts.depth; level++) {
+        width *= opts.fanout;
+        max_dirs += width;
+    }
+    g_dirs = malloc(sizeof(String *) * max_dirs);
+    bench_make_dirs(root, opts.depth, opts.fanout);
+
+    g_files = calloc(opts.files, sizeof(BenchFile));
+    g_num_files = opts.files;
+    g_samples = malloc(sizeof(u64) * MAX_SAMPLES);
+
+    const char *globs[] = { "*.glsl" };
+    g_sub = watcher_subscribe(globs, 1);
+
+    const char *roots[] = { root };
+    WatcherConfig config = {
+        .backend = opts.poll ? WatcherBackend_Poll : WatcherBackend_Inotify,
+        .debounce_ms = opts.debounce_ms,
+        .roots = roots,
+        .num_roots = 1,
+    };
+
+    pthread_t watcher_thread;
+    pthread_t consumer_thread;
+    pthread_create(&watcher_thread, NULL, watcher_start, &config);
+    atomic_store(&g_consuming, true);
+    pthread_create(&consumer_thread, NULL, bench_consume, NULL);
+
+    // There is no ready notification, give the watcher time to add its watches or
+    // take its first snapshot.
+    bench_sleep_ms(200);
+
+    u64 cpu_start_ns = bench_thread_cpu_ns(watcher_thread);
+    u64 start_ns = bench_now_ns();
+    isize creates = 0, modifies = 0, renames = 0;
+
+    for (isize op = 0; op < opts.ops; op++) {
+        isize file = (isize)bench_random((u64)g_num_files);
+        BenchFile *f = &g_files[file];
+        char path[PATH_MAX];
+        u64 kind = bench_random(10);
+
+        if (!f->exists) {
+            f->dir = (isize)bench_random((u64)g_num_dirs);
+            f->exists = true;
+            bench_file_path(path, sizeof(path), file);
+            atomic_store(&f->changed_ns, bench_now_ns());
+            bench_write_file(path, op);
+            creates++;
+        } else if (kind < 7) {
+            bench_file_path(path, sizeof(path), file);
+            atomic_store(&f->changed_ns, bench_now_ns());
+            bench_write_file(path, op);
+            modifies++;
+        } else {
+            char new_path[PATH_MAX];
+            bench_file_path(path, sizeof(path), file);
+            f->dir = (isize)bench_random((u64)g_num_dirs);
+            bench_file_path(new_path, sizeof(new_path), file);
+            atomic_store(&f->changed_ns, bench_now_ns());
+            if (rename(path, new_path) < 0) {
+                LT_FAIL("Could not rename %s: %s\n", path, strerror(errno));
+            }
+            renames++;
+        }
+    }
+
+    u64 churn_ns = bench_now_ns() - start_ns;
+
+    // Wait for the last debounce windows, and for the polling backend to settle.
+    u64 settle_ms = (u64)opts.debounce_ms * 8 + (opts.poll ? 4 * WATCHER_DEFAULT_POLL_MAX_INTERVAL_MS : 200);
+    bench_sleep_ms(settle_ms);
+
+    u64 total_ns = bench_now_ns() - start_ns;
+    u64 watcher_cpu_ns = bench_thread_cpu_ns(watcher_thread) - cpu_start_ns;
+
+    atomic_store(&g_consuming, false);
+    pthread_join(consumer_thread, NULL);
+
+    WatcherStats stats;
+    watcher_get_stats(g_sub, &stats);
+    watcher_stop();
+    pthread_join(watcher_thread, NULL);
+
+    // A file is missed when no event was delivered after its last change.
+    isize missed = 0;
+    for (isize i = 0; i < g_num_files; i++) {
+        if (g_files[i].exists &&
+            atomic_load(&g_files[i].delivered_ns) < atomic_load(&g_files[i].changed_ns)) {
+            missed++;
+        }
+    }
+
+    qsort(g_samples, g_num_samples, sizeof(u64), compare_u64);
+
+    f64 churn_s = (f64)churn_ns / 1e9;
+    printf("\n");
+    printf("Backend:        %s, debounce %dms\n", opts.poll ? "poll" : "inotify", opts.debounce_ms);
+    printf("Tree:           %ld directories, %ld files\n", (long)g_num_dirs, (long)g_num_files);
+    printf("Operations:     %ld creates, %ld modifies, %ld renames in %.3fs (%.0f ops/s)\n",
+           (long)creates, (long)modifies, (long)renames, churn_s, (f64)opts.ops / churn_s);
+    printf("Events:         %llu delivered (%.0f events/s during churn)\n",
+           (unsigned long long)g_num_events, (f64)g_num_events / churn_s);
+    printf("Latency:        p50 %.3fms, p99 %.3fms, max %.3fms (change -> drained)\n",
+           bench_percentile(0.50) / 1e6, bench_percentile(0.99) / 1e6,
+           bench_percentile(1.0) / 1e6);
+    printf("Watcher CPU:    %.3fms (%.1f%% of a core)\n",
+           (f64)watcher_cpu_ns / 1e6, 100.0 * (f64)watcher_cpu_ns / (f64)total_ns);
+    printf("Queue:          high water %ld/%d\n", (long)stats.queue_high_water, WATCHER_MAX_EVENTS);
+    printf("Coalesced:      %llu\n", (unsigned long long)stats.coalesced);
+    printf("Dropped:        %llu events, %llu overflows (%llu seen by the consumer)\n",
+           (unsigned long long)stats.dropped, (unsigned long long)stats.overflows,
+           (unsigned long long)g_num_overflows);
+    printf("Missed files:   %ld (last change never delivered)\n", (long)missed);
+    printf("\n");
+    metrics_dump(stdout);
+
+    char command[PATH_MAX + 16];
+    snprintf(command, sizeof(command), "rm -rf '%s'", root);
+    if (system(command) != 0) {
+        fprintf(stderr, "Could not remove %s\n", root);
+    }
+
+    return missed > 0 && g_num_overflows == 0 ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+#!/bin/sh
+# Checks the shader cache against a real driver, headless on llvmpipe:
+#   1. precompiles the resources into an empty cache, everything is compiled,
+#   2. precompiles again, everything has to be a cache load,
+#   3. truncates one entry and corrupts another, both have to be rebuilt,
+#   4. precompiles once more, everything is a cache load again.
+#
+# Run it with `make check-shader-cache`, or directly:
+#   bench/check_shader_cache.sh [shloader binary] [resources folder]
+# Needs xvfb-run and Mesa.
+set -eu
+
+BIN=${1:-build/shloader}
+RESOURCES=${2:-resources}
+CACHE=$(mktemp -d)
+LOG=$CACHE.log
+trap 'rm -rf "$CACHE" "$LOG"' EXIT
+
+fail() {
+    echo "FAILED: $*"
+    exit 1
+}
+
+# Runs a precompile into the cache, and counts the report lines of its log.
+precompile() {
+    if ! LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a "$BIN" --precompile "$RESOURCES" \
+            --shader-cache "$CACHE" > "$LOG" 2>&1; then
+        cat "$LOG"
+        fail "$BIN --precompile exited with an error"
+    fi
+
+    BUILT=$(sed -n 's/^Built \([0-9]*\) programs.*/\1/p' "$LOG")
+    LOADS=$(grep -c ' cache load ' "$LOG" || true)
+    COMPILES=$(grep -c -E ' compile( and link)? ' "$LOG" || true)
+    STALE=$(grep -c 'Removing stale shader cache entry' "$LOG" || true)
+    echo "  built $BUILT, cache loads $LOADS, compiles $COMPILES, stale entries $STALE"
+}
+
+echo "Cold cache:"
+precompile
+[ "${BUILT:-0}" -gt 0 ] || fail "nothing was built"
+[ "$COMPILES" -eq "$BUILT" ] || fail "expected $BUILT compiles"
+ENTRIES=$(ls "$CACHE" | grep -c '\.bin$' || true)
+[ "$ENTRIES" -eq "$BUILT" ] || fail "expected $BUILT cache entries, found $ENTRIES"
+
+echo "Warm cache:"
+precompile
+[ "$LOADS" -eq "$BUILT" ] || fail "expected $BUILT cache loads"
+
+echo "Damaged entries:"
+DAMAGED=0
+for entry in $(ls "$CACHE"/*.bin | head -n 2); do
+    if [ "$DAMAGED" -eq 0 ]; then
+        # Truncated in the middle of the binary.
+        SIZE=$(wc -c < "$entry")
+        head -c $((SIZE / 2)) "$entry" > "$entry.part"
+        mv "$entry.part" "$entry"
+    else
+        # Same size, but some bytes of the binary flipped.
+        printf 'CORRUPTED' | dd of="$entry" bs=1 seek=40 conv=notrunc 2> /dev/null
+    fi
+    DAMAGED=$((DAMAGED + 1))
+done
+precompile
+[ "$STALE" -eq "$DAMAGED" ] || fail "expected $DAMAGED stale entries"
+[ "$COMPILES" -eq "$DAMAGED" ] || fail "expected $DAMAGED rebuilds"
+[ "$LOADS" -eq $((BUILT - DAMAGED)) ] || fail "expected $((BUILT - DAMAGED)) cache loads"
+
+echo "Repaired cache:"
+precompile
+[ "$LOADS" -eq "$BUILT" ] || fail "expected $BUILT cache loads"
+
+echo "OK"
@@ -5,6 +5,13 @@
  * ==================================== */
 #ifdef COMPILING_VERTEX
 
+#ifdef SEPARABLE_PROGRAM
+// Separable programs have to declare the built-in outputs they write.
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+#endif
+
 layout (location = 0) in vec2 position;
 
 void main() {
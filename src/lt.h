@@ -148,6 +148,9 @@ String *string_make_length(i32 len);
 
 void   string__append_str(String *a, const String *b);
 void   string__append_cstr(String *a, const char *b);
+// Appends the first len bytes of b. The capacity grows geometrically, so building a
+// string out of many small pieces stays linear.
+void   string_append_length(String *a, const char *b, isize len);
 
 String *string__concat_str(const String *a, const String *b);
 String *string__concat_cstr(const char *a, const char *b);
@@ -191,6 +194,17 @@ void          file_free_contents(FileContents *fc);
 isize         file_get_size(const char *filename);
 
 
+/////////////////////////////////////////////////////////
+//
+// Hash
+//
+// Fast non-cryptographic 64 bit hash, based on wyhash (https://github.com/wangyi-fudan/wyhash).
+// Long inputs are consumed 48 bytes at a time in three independent lanes, so the
+// multiplies can run in parallel.
+//
+u64 lt_hash64(const void *data, isize len, u64 seed);
+
+
 /////////////////////////////////////////////////////////
 //
 // Array
@@ -412,6 +426,24 @@ void string__append_cstr(String *a, const char *b) {
     LT_ASSERT(a->data[new_len] == 0);
 }
 
+void string_append_length(String *a, const char *b, isize len) {
+    if (len <= 0) { return; }
+
+    isize new_len = a->len + len;
+
+    if (new_len >= a->capacity) {
+        isize new_capacity = a->capacity * 2;
+        if (new_capacity <= new_len) {
+            new_capacity = new_len + 1;
+        }
+        string__allocate_space(a, new_capacity);
+    }
+
+    memcpy(a->data+a->len, b, len);
+    a->len = new_len;
+    a->data[new_len] = '\0';
+}
+
 String *string_make(const char* cstr) {
     usize len = strlen(cstr);
     usize capacity = len + 1;
@@ -561,6 +593,98 @@ isize file_get_size(const char *filename) {
 #endif
 }
 
+/////////////////////////////////////////////////////////
+//
+// Hash Implementation
+//
+static const u64 lt__hash_secret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+// 64x64 -> 128 bit multiply, with the low half stored in a and the high half in b.
+static inline void lt__hash_mum(u64 *a, u64 *b) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 lt__u128;
+    lt__u128 r = *a;
+    r *= *b;
+    *a = (u64)r;
+    *b = (u64)(r >> 64);
+#else
+    u64 ha = *a >> 32, hb = *b >> 32, la = (u32)*a, lb = (u32)*b;
+    u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    u64 t = rl + (rm0 << 32);
+    u64 c = t < rl;
+    u64 lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline u64 lt__hash_mix(u64 a, u64 b) {
+    lt__hash_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline u64 lt__hash_read8(const u8 *p) {
+    u64 v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline u64 lt__hash_read4(const u8 *p) {
+    u32 v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+u64 lt_hash64(const void *data, isize len, u64 seed) {
+    LT_ASSERT(len >= 0);
+
+    const u8 *p = data;
+    const u64 *s = lt__hash_secret;
+    u64 a, b;
+
+    seed ^= lt__hash_mix(seed ^ s[0], s[1]);
+
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (lt__hash_read4(p) << 32) | lt__hash_read4(p + ((len >> 3) << 2));
+            b = (lt__hash_read4(p + len - 4) << 32) | lt__hash_read4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = ((u64)p[0] << 16) | ((u64)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        isize i = len;
+        if (i > 48) {
+            u64 see1 = seed, see2 = seed;
+            do {
+                seed = lt__hash_mix(lt__hash_read8(p) ^ s[1], lt__hash_read8(p + 8) ^ seed);
+                see1 = lt__hash_mix(lt__hash_read8(p + 16) ^ s[2], lt__hash_read8(p + 24) ^ see1);
+                see2 = lt__hash_mix(lt__hash_read8(p + 32) ^ s[3], lt__hash_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = lt__hash_mix(lt__hash_read8(p) ^ s[1], lt__hash_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = lt__hash_read8(p + i - 16);
+        b = lt__hash_read8(p + i - 8);
+    }
+
+    a ^= s[1];
+    b ^= seed;
+    lt__hash_mum(&a, &b);
+    return lt__hash_mix(a ^ s[0] ^ (u64)len, b ^ s[1]);
+}
+
 void *lt__array_set_capacity(void *array, isize capacity, isize element_size) {
     ArrayHeader *ah = ARRAY_HEADER(array);
 
@@ -1,6 +1,7 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
-#include <linux/inotify.h>
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 
@@ -8,8 +9,12 @@
 #include "lt.h"
 #include "watcher.h"
 #include "shader.h"
+#include "shader_cache.h"
+#include "metrics.h"
 
 bool g_keyboard[1024] = {0};
+WatcherSubscription g_shader_subscription = -1;
+ShaderId g_basic_shader = SHADER_INVALID_ID;
 
 void framebuffer_size_callback(GLFWwindow *w, i32 width, i32 height) {
     LT_UNUSED(w);
@@ -26,20 +31,50 @@ void process_input(GLFWwindow *w) {
 }
 
 void process_watcher_events() {
-    WatcherEvent *ev;
-    while((ev = watcher_peek_event()) != NULL) {
+    if (g_shader_subscription < 0) {
+        return;
+    }
+
+    if (watcher_take_overflow(g_shader_subscription)) {
+        printf("Watcher overflowed, recompiling every shader.\n");
+        shader_reload_all();
+    }
+
+    WatcherEvent events[WATCHER_MAX_EVENTS];
+    isize num_events = watcher_drain(g_shader_subscription, events, WATCHER_MAX_EVENTS);
+    bool needs_recompile = false;
+    u64 reload_origin_ns = 0;
+    u64 now_ns = metrics_now_ns();
+
+    for (isize i = 0; i < num_events; i++) {
+        WatcherEvent *ev = &events[i];
         printf("Consuming Event...\n");
 
+        metrics_record(MetricsStage_Enqueue, ev->enqueue_ns - ev->read_ns);
+        metrics_record(MetricsStage_Dequeue, now_ns - ev->enqueue_ns);
+
         if (ev->inotify_mask & IN_ISDIR) {
             printf("Something happened with directory %s, IGNORING.\n", ev->name->data);
-        } else if (ev->inotify_mask & IN_MODIFY) {
-            shader_recompile(ShaderKind_Basic);
+        } else if (ev->inotify_mask & WATCHER_FILE_CHANGED) {
+            if (!shader_file_changed(ev->name->data)) {
+                printf("No shader is built from %s, IGNORING.\n", ev->name->data);
+                continue;
+            }
+            // The reload is measured from the earliest event that caused it.
+            if (!needs_recompile || ev->read_ns < reload_origin_ns) {
+                reload_origin_ns = ev->read_ns;
+            }
+            needs_recompile = true;
         } else {
             printf("Event on %s is not relevant, IGNORING.\n", ev->name->data);
         }
+    }
 
-        // Notify the watcher that the event was consumed.
-        watcher_event_peeked();
+    // A burst of events only costs a single recompile of every affected program. The
+    // reload is only measured when a build was started, saves that change nothing
+    // never swap a program in.
+    if (needs_recompile && shader_recompile_dirty()) {
+        metrics_reload_begin(reload_origin_ns);
     }
 }
 
@@ -63,11 +98,143 @@ GLFWwindow *create_window_and_set_context(const char *title, i32 width, i32 heig
     return window;
 }
 
-int main(void) {
+void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "  --resources <dir>      Load and watch the shaders of another folder\n");
+    fprintf(stderr, "  --exit-after <s>       Close the window after that many seconds\n");
+    fprintf(stderr, "  --poll-watcher         Scan the files for changes instead of using inotify\n");
+    fprintf(stderr, "  --poll-min <ms>        Shortest interval between two scans\n");
+    fprintf(stderr, "  --poll-max <ms>        Longest interval between two scans, while idle\n");
+    fprintf(stderr, "  --poll-budget <pct>    Percentage of a core the scans may use\n");
+    fprintf(stderr, "  --record-trace <file>  Record the watcher events to a trace\n");
+    fprintf(stderr, "  --record-contents      Save the changed files in the trace as well\n");
+    fprintf(stderr, "  --replay-trace <file>  Replay a trace instead of watching the files\n");
+    fprintf(stderr, "  --replay-speed <x>     Replay x times faster, negative for no waits\n");
+    fprintf(stderr, "  --shader-cache <dir>   Folder of the program binary cache\n");
+    fprintf(stderr, "  --no-shader-cache      Always compile the shaders\n");
+    fprintf(stderr, "  --no-compile-thread    Compile the shaders on the render thread\n");
+    fprintf(stderr, "  --separable            Build every stage as a separable program\n");
+    fprintf(stderr, "  --precompile <dir>     Build the shaders of the folder into the shader\n");
+    fprintf(stderr, "                         cache without a window, and exit\n");
+    fprintf(stderr, "  --validate-only        With --precompile, only check that the shaders\n");
+    fprintf(stderr, "                         build, without the shader cache. Implied by\n");
+    fprintf(stderr, "                         --separable, separable programs are not cached\n");
+}
+
+// Builds every shader and variant of the folder, filling the shader cache. Nothing
+// is shown, the hidden window only provides a context. Filling the cache is the
+// point, so a cache that is disabled or not supported fails the run, unless the
+// shaders are only validated, which separable programs always are. Returns the exit
+// code.
+i32 precompile(const char *dir, const char *shader_cache_dir, bool use_shader_cache,
+               bool use_separable, bool validate_only) {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = create_window_and_set_context("Hot Shader Loader", 1, 1);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        LT_FAIL("Failed to initialize GLAD\n");
+    }
+
+    printf("Using %s\n", (const char *)glGetString(GL_RENDERER));
+    // Only whole programs are kept in the shader cache, separable ones are validated.
+    if (shader_use_separable_programs(use_separable) && !validate_only) {
+        printf("Separable programs are not cached, only checking that the shaders build\n");
+        validate_only = true;
+    }
+    if (!validate_only &&
+        (!use_shader_cache ||
+         !shader_cache_initialize(shader_cache_dir, SHADER_CACHE_DEFAULT_MAX_BYTES))) {
+        fprintf(stderr, "The shader cache is not available, nothing would be precompiled. "
+                        "Use --validate-only to only check that the shaders build.\n");
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 1;
+    }
+
+    shader_set_resources_path(dir);
+    bool success = shader_precompile();
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return success ? 0 : 1;
+}
+
+int main(i32 argc, char **argv) {
     const i32 WINDOW_WIDTH = 800;
     const i32 WINDOW_HEIGHT = 600;
 
-    glfwInit();
+    WatcherConfig watcher_config = {
+        .debounce_ms = WATCHER_DEFAULT_DEBOUNCE_MS,
+    };
+
+    const char *shader_cache_dir = NULL;
+    bool use_shader_cache = true;
+    bool use_compile_thread = true;
+    bool use_separable = false;
+    const char *precompile_dir = NULL;
+    bool validate_only = false;
+    const char *resources_dir = NULL;
+    f64 exit_after_s = 0.0;
+
+    for (i32 i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--resources") == 0 && has_value) {
+            resources_dir = argv[++i];
+        } else if (strcmp(argv[i], "--exit-after") == 0 && has_value) {
+            exit_after_s = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--poll-watcher") == 0) {
+            watcher_config.backend = WatcherBackend_Poll;
+        } else if (strcmp(argv[i], "--poll-min") == 0 && has_value) {
+            watcher_config.poll_min_interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--poll-max") == 0 && has_value) {
+            watcher_config.poll_max_interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--poll-budget") == 0 && has_value) {
+            watcher_config.poll_cpu_budget_percent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--record-trace") == 0 && has_value) {
+            watcher_config.record_path = argv[++i];
+        } else if (strcmp(argv[i], "--record-contents") == 0) {
+            watcher_config.record_contents = true;
+        } else if (strcmp(argv[i], "--replay-trace") == 0 && has_value) {
+            watcher_config.backend = WatcherBackend_Replay;
+            watcher_config.replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay-speed") == 0 && has_value) {
+            watcher_config.replay_speed = (f32)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--shader-cache") == 0 && has_value) {
+            shader_cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--no-shader-cache") == 0) {
+            use_shader_cache = false;
+        } else if (strcmp(argv[i], "--no-compile-thread") == 0) {
+            use_compile_thread = false;
+        } else if (strcmp(argv[i], "--separable") == 0) {
+            use_separable = true;
+        } else if (strcmp(argv[i], "--precompile") == 0 && has_value) {
+            precompile_dir = argv[++i];
+        } else if (strcmp(argv[i], "--validate-only") == 0) {
+            validate_only = true;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (resources_dir != NULL) {
+        shader_set_resources_path(resources_dir);
+        watcher_config.roots = &resources_dir;
+        watcher_config.num_roots = 1;
+    }
+#ifndef DEV_ENV
+    // Nothing is watched outside of the development environment.
+    LT_UNUSED(watcher_config);
+#endif
+
+    if (!glfwInit()) {
+        LT_FAIL("Failed to initialize glfw.\n");
+    }
+
+    if (precompile_dir != NULL) {
+        return precompile(precompile_dir, shader_cache_dir, use_shader_cache, use_separable,
+                          validate_only);
+    }
 
     GLFWwindow *window = create_window_and_set_context("Hot Shader Loader", WINDOW_WIDTH, WINDOW_HEIGHT);
 
@@ -78,12 +245,46 @@ int main(void) {
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 
 #ifdef DEV_ENV
+    // Temporary and backup files written by editors while saving.
+    watcher_ignore("*.swp");
+    watcher_ignore("*.swx");
+    watcher_ignore("*~");
+    watcher_ignore("4913");
+    watcher_ignore(".#*");
+
+    const char *shader_globs[] = { "*.glsl", "shaders.manifest" };
+    g_shader_subscription = watcher_subscribe(shader_globs, 2);
+
     pthread_t watcher_thread;
-    pthread_create(&watcher_thread, NULL, watcher_start, NULL);
+    pthread_create(&watcher_thread, NULL, watcher_start, &watcher_config);
 #endif
 
+    if (use_shader_cache) {
+        shader_cache_initialize(shader_cache_dir, SHADER_CACHE_DEFAULT_MAX_BYTES);
+    }
+    shader_use_separable_programs(use_separable);
     shader_initialize();
 
+    g_basic_shader = shader_find("basic");
+    if (g_basic_shader == SHADER_INVALID_ID) {
+        LT_FAIL("The shader manifest has no basic shader.\n");
+    }
+
+    // Hidden window, its context shares the programs with the one of the main window.
+    GLFWwindow *compile_context = NULL;
+    if (use_compile_thread) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        compile_context = glfwCreateWindow(1, 1, "Shader compiler", NULL, window);
+
+        if (compile_context != NULL && !shader_start_compile_thread(compile_context)) {
+            glfwDestroyWindow(compile_context);
+            compile_context = NULL;
+        }
+        if (compile_context == NULL) {
+            printf("Compiling the shaders on the render thread\n");
+        }
+    }
+
     GLfloat vertices[] = {
         0.0f, 1.0f,
         1.0f, 0.0f,
@@ -106,6 +307,11 @@ int main(void) {
     while (running) {
         process_input(window);
         process_watcher_events();
+        shader_update();
+
+        if (exit_after_s > 0.0 && glfwGetTime() >= exit_after_s) {
+            glfwSetWindowShouldClose(window, true);
+        }
 
         if (glfwWindowShouldClose(window)) {
             running = false;
@@ -118,19 +324,25 @@ int main(void) {
         glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(shader_get_program(ShaderKind_Basic));
+        shader_bind(g_basic_shader);
         glBindVertexArray(vao);
         glDrawArrays(GL_TRIANGLES, 0, 3);
         glBindVertexArray(0);
-        glUseProgram(0);
+        shader_unbind();
+        metrics_frame_drawn();
 
         glfwPollEvents();
         glfwSwapBuffers(window);
     }
 
+    shader_stop_compile_thread();
+    if (compile_context != NULL) {
+        glfwDestroyWindow(compile_context);
+    }
     glfwDestroyWindow(window);
     glfwTerminate();
 #ifdef DEV_ENV
     pthread_join(watcher_thread, NULL);
 #endif
+    metrics_dump(stdout);
 }
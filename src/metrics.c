@@ -0,0 +1,161 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <time.h>
+#include <stdio.h>
+
+#include "metrics.h"
+#include "lt.h"
+
+// Log-linear buckets: every power of two is split into 4 sub buckets, so the
+// percentiles are within ~20% of the real value.
+#define SUB_BUCKET_BITS 2
+#define SUB_BUCKETS     (1 << SUB_BUCKET_BITS)
+#define NUM_BUCKETS     (64 * SUB_BUCKETS)
+
+typedef struct Histogram {
+    u64 buckets[NUM_BUCKETS];
+    u64 count;
+    u64 sum_ns;
+    u64 min_ns;
+    u64 max_ns;
+} Histogram;
+
+static const char *g_stage_names[MetricsStage_Count] = {
+    "enqueue",
+    "dequeue",
+    "source read",
+    "compile",
+    "link",
+    "cache load",
+    "swap",
+    "first draw",
+    "end to end",
+    "frame",
+    "reload frame",
+};
+
+static Histogram g_histograms[MetricsStage_Count];
+// Reload in flight. Zero when there is none.
+static u64       g_reload_origin_ns  = 0;
+static u64       g_reload_swapped_ns = 0;
+// When the previous frame was drawn. Zero before the first one.
+static u64       g_last_frame_ns     = 0;
+
+u64 metrics_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+i32 bucket_index(u64 ns) {
+    if (ns < SUB_BUCKETS) {
+        return (i32)ns;
+    }
+
+    i32 msb = 63 - __builtin_clzll(ns);
+    i32 sub = (i32)((ns >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return msb * SUB_BUCKETS + sub;
+}
+
+// Middle of the range of values falling in the bucket.
+u64 bucket_value(i32 index) {
+    if (index < SUB_BUCKETS) {
+        return (u64)index;
+    }
+
+    i32 msb = index / SUB_BUCKETS;
+    u64 sub = (u64)(index % SUB_BUCKETS);
+    u64 low = (1ull << msb) | (sub << (msb - SUB_BUCKET_BITS));
+    return low + (1ull << (msb - SUB_BUCKET_BITS)) / 2;
+}
+
+void metrics_record(MetricsStage stage, u64 duration_ns) {
+    LT_ASSERT(stage >= 0 && stage < MetricsStage_Count);
+    Histogram *h = &g_histograms[stage];
+
+    if (h->count == 0 || duration_ns < h->min_ns) {
+        h->min_ns = duration_ns;
+    }
+    if (duration_ns > h->max_ns) {
+        h->max_ns = duration_ns;
+    }
+    h->buckets[bucket_index(duration_ns)]++;
+    h->count++;
+    h->sum_ns += duration_ns;
+}
+
+u64 histogram_percentile(const Histogram *h, f64 percentile) {
+    u64 rank = (u64)(percentile * (f64)(h->count - 1)) + 1;
+    u64 seen = 0;
+
+    for (i32 i = 0; i < NUM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            // The estimate can not fall outside of what was actually recorded.
+            return lt_max(lt_min(bucket_value(i), h->max_ns), h->min_ns);
+        }
+    }
+    return h->max_ns;
+}
+
+// The swap is kept until the end of the frame, a program loaded from the cache is
+// swapped in before its reload begins.
+void metrics_reload_begin(u64 origin_ns) {
+    g_reload_origin_ns = origin_ns;
+}
+
+void metrics_reload_cancel() {
+    g_reload_origin_ns = 0;
+}
+
+void metrics_reload_swapped() {
+    g_reload_swapped_ns = metrics_now_ns();
+}
+
+void metrics_frame_drawn() {
+    u64 now_ns = metrics_now_ns();
+
+    if (g_last_frame_ns != 0) {
+        metrics_record(MetricsStage_Frame, now_ns - g_last_frame_ns);
+        // A reload should not be visible in the frame times, building the program
+        // is not supposed to block the render thread.
+        if (g_reload_origin_ns != 0) {
+            metrics_record(MetricsStage_ReloadFrame, now_ns - g_last_frame_ns);
+        }
+    }
+    g_last_frame_ns = now_ns;
+
+    if (g_reload_swapped_ns == 0) {
+        return;
+    }
+
+    if (g_reload_origin_ns != 0) {
+        metrics_record(MetricsStage_FirstDraw, now_ns - g_reload_swapped_ns);
+        metrics_record(MetricsStage_EndToEnd, now_ns - g_reload_origin_ns);
+    }
+    g_reload_origin_ns = 0;
+    g_reload_swapped_ns = 0;
+}
+
+void metrics_dump(FILE *fp) {
+    fprintf(fp, "Hot reload latency and frame times (ms):\n");
+    fprintf(fp, "  %-12s %8s %10s %10s %10s %10s\n", "stage", "count", "avg", "p50", "p99", "max");
+
+    for (i32 s = 0; s < MetricsStage_Count; s++) {
+        const Histogram *h = &g_histograms[s];
+
+        if (h->count == 0) {
+            fprintf(fp, "  %-12s %8d %10s %10s %10s %10s\n", g_stage_names[s], 0, "-", "-", "-", "-");
+            continue;
+        }
+
+        fprintf(fp, "  %-12s %8llu %10.3f %10.3f %10.3f %10.3f\n",
+                g_stage_names[s],
+                (unsigned long long)h->count,
+                (f64)h->sum_ns / (f64)h->count / 1e6,
+                (f64)histogram_percentile(h, 0.50) / 1e6,
+                (f64)histogram_percentile(h, 0.99) / 1e6,
+                (f64)h->max_ns / 1e6);
+    }
+}
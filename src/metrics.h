@@ -0,0 +1,44 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+
+#include "lt.h"
+
+// Stages of a hot reload, from the kernel reporting a file change until the new
+// program is used by a frame, and the frame times around them.
+typedef enum MetricsStage {
+    MetricsStage_Enqueue,     // Watcher read the event -> event queued (includes the debounce)
+    MetricsStage_Dequeue,     // Event queued -> drained by the render thread
+    MetricsStage_SourceRead,  // Reading the shader source
+    MetricsStage_Compile,     // Compiling every stage
+    MetricsStage_Link,        // Linking the program
+    MetricsStage_CacheLoad,   // Loading the program binary from the cache instead
+    MetricsStage_Swap,        // Replacing the old program
+    MetricsStage_FirstDraw,   // Program swapped -> first frame drawn with it
+    MetricsStage_EndToEnd,    // Watcher read the event -> first frame drawn
+    MetricsStage_Frame,       // Time between two frames
+    MetricsStage_ReloadFrame, // Same, only the frames drawn while a reload is in flight
+    MetricsStage_Count
+} MetricsStage;
+
+// Monotonic time in nanoseconds, the same clock (CLOCK_MONOTONIC) used for the
+// timestamps of watcher events.
+u64  metrics_now_ns();
+// Adds a duration to the histogram of the stage. Not thread safe, every stage is
+// recorded from the render thread.
+void metrics_record(MetricsStage stage, u64 duration_ns);
+
+// A reload starts with the earliest watcher event that caused it, once a build for
+// it was started, and ends at the first frame drawn after its program was swapped in.
+void metrics_reload_begin(u64 origin_ns);
+// Forgets the reload in flight when its build failed or was dropped, so a later swap
+// is not measured from its origin.
+void metrics_reload_cancel();
+void metrics_reload_swapped();
+// Called once per frame, also records the frame times.
+void metrics_frame_drawn();
+
+void metrics_dump(FILE *fp);
+
+#endif // METRICS_H
@@ -1,25 +1,242 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "glad/glad.h"
+#include <GLFW/glfw3.h>
 
 #include "shader.h"
+#include "shader_cache.h"
+#include "metrics.h"
 #include "lt.h"
 
+// Every shader file has both stages, selected with COMPILING_VERTEX and
+// COMPILING_FRAGMENT.
+#define NUM_STAGES 2
+// Compiled stages kept around to be linked again, see StageObject.
+#define MAX_STAGE_OBJECTS 64
+// Nested conditionals deeper than this are left to the compiler.
+#define MAX_STAGE_BLOCKS  64
+// Charged to the variant budget when the driver does not report the size of a program.
+#define VARIANT_ESTIMATED_SIZE (64 * 1024)
+// Most defines a variant of the manifest can have.
+#define MAX_VARIANT_DEFINES    32
+
 typedef struct Shader {
-    GLuint program;
+    String *name;
+    // Main source file, relative to the resources folder.
+    String *file;
+    GLuint  program;
+    // In separable mode the stages are programs of their own, bound through the
+    // pipeline instead of program.
+    GLuint  pipeline;
+    GLuint  stage_programs[NUM_STAGES];
+    // Hash of the source the program was built from. Saves that leave the bytes
+    // untouched (touch, formatters, branch switches) are skipped by comparing it.
+    u64     source_hash;
+    // Hash of the latest expansion of its source. Variants are rebuilt when it changes.
+    u64     expanded_hash;
+    // Hash of the source handed to the compile thread, 0 when it is not building
+    // this shader. Results built from any other source are dropped.
+    u64     building_hash;
+    // Set when one of its sources changed, cleared when it is recompiled.
+    bool    dirty;
 } Shader;
 
+// Time spent building a program. Builds running on the compile thread hand them
+// over, since only the render thread records metrics.
+typedef struct BuildTimes {
+    u64 compile_ns;
+    u64 link_ns;
+    u64 cache_load_ns;
+} BuildTimes;
+
+// Program being compiled and linked by the driver. Its status is only queried once
+// the driver is done with it, so the render thread keeps drawing with the old
+// program in the meantime.
+typedef struct PendingProgram {
+    ShaderId id;
+    u64      variant_key; // 0 for the program of the shader itself.
+    GLuint   shaders[NUM_STAGES];
+    // Key of every stage in the stage object cache, and whether the shader object
+    // came from it instead of being compiled for this program.
+    u64      stage_keys[NUM_STAGES];
+    bool     reused[NUM_STAGES];
+    // Separable programs of every stage, in separable mode.
+    GLuint   stage_programs[NUM_STAGES];
+    GLuint   program;
+    u64      cache_key;
+    u64      source_hash;
+    u64      submit_ns;
+} PendingProgram;
+
+// Source strings of every stage: the version, the stage define, the defines of the
+// variant and the text. Each stage gets the expanded text with the branches of the
+// other stages blanked out, so it only changes when the text the stage actually
+// compiles changes.
+typedef struct StageSources {
+    String     *text[NUM_STAGES];
+    const char *strings[NUM_STAGES][4];
+} StageSources;
+
+// Shader built with extra defines, see shader_get_variant.
+typedef struct ShaderVariant {
+    u64      key; // See shader_variant_key.
+    ShaderId id;
+    // One #define line per define, added to the sources after the stage define.
+    String  *defines;
+    // The defines as `NAME=VALUE` words, for the messages.
+    String  *label;
+    GLuint   program;
+    // Hash of the source the program was built from, and of the one being built.
+    u64      source_hash;
+    u64      building_hash;
+    // Bytes charged to the variant budget.
+    u64      size;
+    // Frame it was last requested in.
+    u64      last_used;
+} ShaderVariant;
+
+// Compiled shader object of a stage, kept so a program whose other stage changed
+// is only relinked. Used by one thread at a time, like the program binary cache.
+typedef struct StageObject {
+    u64    key; // See shader_stage_key.
+    GLuint shader;
+    u64    last_used;
+} StageObject;
+
+// Separable program of a stage, shared by every pipeline using the same stage text.
+typedef struct StageProgram {
+    u64    key; // See shader_stage_key.
+    GLuint program;
+    // Pipelines using it. Only unused programs are evicted.
+    i32    refs;
+    u64    last_used;
+} StageProgram;
+
+// Conditional of the preprocessor, while blanking out the text of the other stages.
+typedef struct StageBlock {
+    // Set for #ifdef and #ifndef of a stage define, whose branches are resolved
+    // here. Any other conditional is left to the compiler.
+    bool resolved;
+    bool active;
+} StageBlock;
+
+// Variant listed in the manifest, built by shader_precompile.
+typedef struct ManifestVariant {
+    ShaderId id;
+    // The defines as written in the manifest, `NAME` or `NAME=VALUE` words.
+    String  *defines;
+} ManifestVariant;
+
+// Program built by the compile thread, and handed back to the render thread once
+// the commands building it completed.
+typedef struct CompileJob {
+    ShaderId   id;
+    u64        variant_key;
+    u64        source_hash;
+    // Expanded source and defines of the variant, owned by the job until the
+    // compile thread built it. The defines are NULL for the program of the shader.
+    String    *source;
+    String    *defines;
+    GLuint     program; // 0 if the build failed.
+    // Signaled once the GPU executed every command building the program. Sync
+    // objects are shared between the contexts, so the render thread can query it.
+    GLsync     fence;
+    BuildTimes times;
+} CompileJob;
+
+// Source file, the programs built from it and its place in the include graph.
+typedef struct ShaderSource {
+    u64              hash;
+    String          *path; // Relative to the resources folder.
+    // Source string number used in the #line directives of the expansions, so
+    // compiler errors can be traced back to the file.
+    i32              id;
+    Array(ShaderId)  dependents;
+    // Contents with every #include replaced by the expansion of the included file.
+    // NULL when the file, or a file it includes, changed since it was expanded.
+    String          *expanded;
+    // Files included directly, and files including this one directly. They point
+    // to the paths of the other entries, which are never freed.
+    Array(const String *) includes;
+    Array(const String *) includers;
+    // Set while the file is expanded, so include cycles are caught.
+    bool             expanding;
+} ShaderSource;
+
+// Reverse index from source path to the programs depending on it, using open
+// addressing with linear probing. Empty slots have a NULL path.
+typedef struct SourceTable {
+    ShaderSource *entries;
+    isize         capacity; // Always a power of two.
+    isize         count;
+} SourceTable;
+
 static const char *resources_path = "/home/lhahn/dev/c/shader-loader/resources/";
-static Shader g_shaders[ShaderKind_Count] = {{0}};
+// Nested includes deeper than this are reported as errors.
+#define MAX_INCLUDE_DEPTH 32
+// Longest path of a source file, relative to the resources folder.
+#define MAX_SOURCE_PATH   512
+// Set by shader_set_resources_path.
+static char g_resources_dir[MAX_SOURCE_PATH];
 
-Shader shader_get(ShaderKind kind) {
-    LT_ASSERT(kind != ShaderKind_Count);
-    return g_shaders[kind];
-}
+// Lists every shader, relative to the resources folder.
+static const char *manifest_file = "shaders.manifest";
+// Registry, indexed by ShaderId. Shaders are only ever added, so ids stay valid.
+static Array(Shader) g_shaders = NULL;
+static SourceTable g_sources = {0};
+// Programs submitted to the driver and not swapped in yet.
+static Array(PendingProgram) g_pending = NULL;
+static Array(StageObject) g_stage_objects = NULL;
+static Array(StageProgram) g_stage_programs = NULL;
+static u64 g_stage_clock = 0;
+// Every stage is a separable program, see shader_use_separable_programs.
+static bool g_separable = false;
+static Array(ShaderVariant) g_variants = NULL;
+static Array(ManifestVariant) g_manifest_variants = NULL;
+static u64 g_variant_budget = SHADER_VARIANT_DEFAULT_BUDGET;
+static u64 g_variant_bytes = 0;
+// Counts the calls to shader_update, the frame boundaries.
+static u64 g_frame = 0;
+// Set by shader_precompile, every finished build is reported and counted.
+static bool g_precompiling = false;
+static i32 g_num_builds = 0;
+static i32 g_failed_builds = 0;
+
+// Hidden context shared with the render context, current on the compile thread.
+// NULL when the programs are built on the render thread.
+static GLFWwindow *g_compile_context = NULL;
+static pthread_t g_compile_thread;
+// Guards both job queues and g_compile_quit.
+static pthread_mutex_t g_compile_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Signaled when a job is queued, or the thread has to quit.
+static pthread_cond_t g_compile_cond = PTHREAD_COND_INITIALIZER;
+// Signaled when a build finished.
+static pthread_cond_t g_compile_done_cond = PTHREAD_COND_INITIALIZER;
+static Array(CompileJob) g_compile_jobs = NULL;    // Waiting for the compile thread.
+static Array(CompileJob) g_compile_results = NULL; // Waiting for the render thread.
+static bool g_compile_quit = false;
 
-GLuint shader_make_program(const char* shader_name) {
-    // Fetch source codes from each shader
+static const GLenum g_stage_types[NUM_STAGES] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+static const char *g_stage_defines[NUM_STAGES] = {
+    "#define COMPILING_VERTEX\n",
+    "#define COMPILING_FRAGMENT\n",
+};
+static const char *g_stage_define_names[NUM_STAGES] = { "COMPILING_VERTEX", "COMPILING_FRAGMENT" };
+static const GLbitfield g_stage_bits[NUM_STAGES] = { GL_VERTEX_SHADER_BIT, GL_FRAGMENT_SHADER_BIT };
+// First source string of every stage. Separable programs have to redeclare the
+// built-in outputs they write, which shaders do under SEPARABLE_PROGRAM.
+static const char *g_version_header = "#version 330 core\n";
+static const char *g_separable_version_header =
+    "#version 330 core\n"
+    "#extension GL_ARB_separate_shader_objects : require\n"
+    "#define SEPARABLE_PROGRAM\n";
+static const char *g_stage_names[NUM_STAGES] = { "Vertex", "Fragment" };
+
+// Reads the source of a shader from the resources folder. Returns NULL on failure.
+String *shader_read_source(const char *shader_name) {
     String *shader_src_path = string_make(resources_path);
     string_append(shader_src_path, shader_name);
 
@@ -31,132 +248,1794 @@ GLuint shader_make_program(const char* shader_name) {
         fprintf(stderr, "Error reading shader source from %s\n", shader_src_path->data);
         string_free(shader_src_path);
         file_free_contents(shader_src);
-        return 0;
+        return NULL;
     }
 
     String *shader_string = string_make_ptrs((u8*)shader_src->data,
                                              (u8*)shader_src->data + shader_src->size - 1);
 
     file_free_contents(shader_src);
+    string_free(shader_src_path);
+    return shader_string;
+}
 
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+u64 shader_hash_source(const String *shader_string) {
+    return lt_hash64(shader_string->data, shader_string->len, 0);
+}
 
-    if (vertex_shader == 0 || fragment_shader == 0) {
-        fprintf(stderr, "Error creating shaders (glCreateShader)\n");
-        string_free(shader_src_path);
-        file_free_contents(shader_src);
-        glDeleteShader(vertex_shader);
-        glDeleteShader(fragment_shader);
-        return 0;
+// Splits a preprocessor directive into its name and the first word after it.
+// Returns false if the line is not a directive.
+bool directive_parse(const char *line, const char *line_end, const char **name,
+                     isize *name_len, const char **arg, isize *arg_len) {
+    const char *c = line;
+
+    while (c < line_end && (*c == ' ' || *c == '\t')) { c++; }
+    if (c == line_end || *c != '#') {
+        return false;
+    }
+    c++;
+    while (c < line_end && (*c == ' ' || *c == '\t')) { c++; }
+
+    *name = c;
+    while (c < line_end && *c >= 'a' && *c <= 'z') { c++; }
+    *name_len = c - *name;
+
+    while (c < line_end && (*c == ' ' || *c == '\t')) { c++; }
+    *arg = c;
+    while (c < line_end && *c != ' ' && *c != '\t' && *c != '\r') { c++; }
+    *arg_len = c - *arg;
+    return true;
+}
+
+bool directive_is(const char *name, isize name_len, const char *directive) {
+    return name != NULL && name_len == (isize)strlen(directive) && strncmp(name, directive, name_len) == 0;
+}
+
+// Returns the stage whose define is the word, or -1.
+i32 stage_from_define(const char *word, isize word_len) {
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        if (directive_is(word, word_len, g_stage_define_names[stage])) {
+            return stage;
+        }
+    }
+    return -1;
+}
+
+// Returns the expanded text as compiled by a stage, with the lines of the branches
+// of the other stages left empty, so line numbers do not move. Text the filter does
+// not understand, like an #elif of a stage define, is returned untouched.
+String *shader_stage_text(const String *shader_string, i32 stage) {
+    StageBlock blocks[MAX_STAGE_BLOCKS];
+    i32 num_blocks = 0;
+    // Resolved blocks whose branch is not compiled by the stage.
+    i32 num_inactive = 0;
+    bool unfiltered = false;
+
+    String *text = string_make("");
+    const char *line = shader_string->data;
+    const char *end = shader_string->data + shader_string->len;
+
+    while (line < end && !unfiltered) {
+        const char *line_end = memchr(line, '\n', end - line);
+        line_end = line_end ? line_end : end;
+
+        bool keep = num_inactive == 0;
+        const char *name = NULL, *arg = NULL;
+        isize name_len = 0, arg_len = 0;
+        directive_parse(line, line_end, &name, &name_len, &arg, &arg_len);
+
+        if (directive_is(name, name_len, "if") || directive_is(name, name_len, "ifdef") ||
+            directive_is(name, name_len, "ifndef")) {
+            if (num_blocks == MAX_STAGE_BLOCKS) {
+                unfiltered = true;
+                break;
+            }
+
+            StageBlock block = {0};
+            i32 define_stage = stage_from_define(arg, arg_len);
+            if (!directive_is(name, name_len, "if") && define_stage >= 0) {
+                block.resolved = true;
+                block.active = (define_stage == stage) == directive_is(name, name_len, "ifdef");
+                num_inactive += block.active ? 0 : 1;
+                keep = false;
+            }
+            blocks[num_blocks++] = block;
+        } else if (directive_is(name, name_len, "else") || directive_is(name, name_len, "elif")) {
+            StageBlock *block = num_blocks > 0 ? &blocks[num_blocks - 1] : NULL;
+            if (block == NULL || (block->resolved && directive_is(name, name_len, "elif"))) {
+                unfiltered = true;
+                break;
+            }
+            if (block->resolved) {
+                num_inactive += block->active ? 1 : -1;
+                block->active = !block->active;
+                keep = false;
+            }
+        } else if (directive_is(name, name_len, "endif")) {
+            if (num_blocks == 0) {
+                unfiltered = true;
+                break;
+            }
+            StageBlock *block = &blocks[--num_blocks];
+            if (block->resolved) {
+                num_inactive -= block->active ? 0 : 1;
+                keep = false;
+            }
+        }
+
+        if (keep) {
+            string_append_length(text, line, line_end - line);
+        }
+        string_append_length(text, "\n", 1);
+        line = line_end + 1;
+    }
+
+    if (unfiltered || num_blocks != 0) {
+        string_free(text);
+        return string_make(shader_string->data);
+    }
+    return text;
+}
+
+// Builds the source strings of every stage out of the expanded shader and the
+// defines of the variant. They have to be released with shader_free_stage_sources.
+void shader_stage_sources(const String *shader_string, const char *defines, StageSources *sources) {
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        sources->text[stage] = shader_stage_text(shader_string, stage);
+        sources->strings[stage][0] = g_separable ? g_separable_version_header : g_version_header;
+        sources->strings[stage][1] = g_stage_defines[stage];
+        sources->strings[stage][2] = defines;
+        sources->strings[stage][3] = sources->text[stage]->data;
+    }
+}
+
+void shader_free_stage_sources(StageSources *sources) {
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        string_free(sources->text[stage]);
+    }
+}
+
+u64 shader_program_cache_key(const StageSources *sources) {
+    const char *const *stage_sources[NUM_STAGES];
+    isize num_sources[NUM_STAGES];
+
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        stage_sources[stage] = sources->strings[stage];
+        num_sources[stage] = 4;
+    }
+    return shader_cache_key(stage_sources, num_sources, NUM_STAGES);
+}
+
+u64 shader_stage_key(i32 stage, const StageSources *sources) {
+    u64 key = lt_hash64(&g_stage_types[stage], sizeof(g_stage_types[stage]), 0);
+
+    for (i32 i = 0; i < 4; i++) {
+        const char *str = sources->strings[stage][i];
+        isize len = (isize)strlen(str);
+        key = lt_hash64(&len, sizeof(len), key);
+        key = lt_hash64(str, len, key);
+    }
+    return key;
+}
+
+// Returns the compiled shader object of the stage key, or 0.
+GLuint stage_object_find(u64 key) {
+    for (isize i = 0; i < array_length(g_stage_objects); i++) {
+        if (g_stage_objects[i].key == key) {
+            g_stage_objects[i].last_used = ++g_stage_clock;
+            return g_stage_objects[i].shader;
+        }
+    }
+    return 0;
+}
+
+// Keeps a successfully compiled shader object, evicting the least recently used
+// one when the cache is full. Programs linked with an evicted object keep working.
+// Builds submitted together can compile the same stage, only the first one is kept
+// and the others are deleted. Returns the cached object.
+GLuint stage_object_add(u64 key, GLuint shader) {
+    GLuint existing = stage_object_find(key);
+    if (existing != 0) {
+        // Attached objects are only deleted along with their program.
+        glDeleteShader(shader);
+        return existing;
+    }
+
+    if (array_length(g_stage_objects) == MAX_STAGE_OBJECTS) {
+        isize oldest = 0;
+        for (isize i = 1; i < array_length(g_stage_objects); i++) {
+            if (g_stage_objects[i].last_used < g_stage_objects[oldest].last_used) {
+                oldest = i;
+            }
+        }
+        glDeleteShader(g_stage_objects[oldest].shader);
+        g_stage_objects[oldest] = g_stage_objects[array_length(g_stage_objects) - 1];
+        array_length(g_stage_objects)--;
+    }
+
+    StageObject object = {0};
+    object.key = key;
+    object.shader = shader;
+    object.last_used = ++g_stage_clock;
+    array_append(g_stage_objects, object);
+    return shader;
+}
+
+// Returns the separable program of the stage key, or 0.
+GLuint stage_program_find(u64 key) {
+    for (isize i = 0; i < array_length(g_stage_programs); i++) {
+        if (g_stage_programs[i].key == key) {
+            g_stage_programs[i].last_used = ++g_stage_clock;
+            return g_stage_programs[i].program;
+        }
+    }
+    return 0;
+}
+
+// Keeps a linked separable program. Like stage_object_add, a program built again
+// for a key already cached is deleted, and the cached program is returned.
+GLuint stage_program_add(u64 key, GLuint program) {
+    GLuint existing = stage_program_find(key);
+    if (existing != 0) {
+        glDeleteProgram(program);
+        return existing;
+    }
+
+    StageProgram stage_program = {0};
+    stage_program.key = key;
+    stage_program.program = program;
+    stage_program.last_used = ++g_stage_clock;
+    array_append(g_stage_programs, stage_program);
+    return program;
+}
+
+void stage_program_ref(GLuint program, i32 delta) {
+    for (isize i = 0; i < array_length(g_stage_programs); i++) {
+        if (g_stage_programs[i].program == program) {
+            g_stage_programs[i].refs += delta;
+            LT_ASSERT(g_stage_programs[i].refs >= 0);
+            return;
+        }
+    }
+}
+
+// Deletes the least recently used stage programs no pipeline uses, until the cache
+// fits in its limit.
+void stage_program_trim() {
+    while (array_length(g_stage_programs) > MAX_STAGE_OBJECTS) {
+        isize oldest = -1;
+        for (isize i = 0; i < array_length(g_stage_programs); i++) {
+            if (g_stage_programs[i].refs == 0 &&
+                (oldest < 0 || g_stage_programs[i].last_used < g_stage_programs[oldest].last_used)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            return;
+        }
+        glDeleteProgram(g_stage_programs[oldest].program);
+        g_stage_programs[oldest] = g_stage_programs[array_length(g_stage_programs) - 1];
+        array_length(g_stage_programs)--;
+    }
+}
+
+// Deletes the shader objects of the program that are not in the stage object cache.
+void shader_release_stages(PendingProgram *pending) {
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        if (!pending->reused[stage]) {
+            glDeleteShader(pending->shaders[stage]);
+            glDeleteProgram(pending->stage_programs[stage]);
+        }
+    }
+}
+
+// Separable mode version of shader_submit_program. Every stage missing from the
+// stage program cache is compiled and linked into a separable program of its own.
+bool shader_submit_stages(const StageSources *sources, PendingProgram *pending) {
+    memset(pending->stage_programs, 0, sizeof(pending->stage_programs));
+    memset(pending->reused, 0, sizeof(pending->reused));
+    pending->submit_ns = metrics_now_ns();
+
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        pending->stage_keys[stage] = shader_stage_key(stage, sources);
+        pending->stage_programs[stage] = stage_program_find(pending->stage_keys[stage]);
+
+        if (pending->stage_programs[stage] != 0) {
+            pending->reused[stage] = true;
+            continue;
+        }
+
+        pending->stage_programs[stage] = glCreateShaderProgramv(g_stage_types[stage], 4,
+                                                                sources->strings[stage]);
+        if (pending->stage_programs[stage] == 0) {
+            fprintf(stderr, "Error creating shaders (glCreateShaderProgramv)\n");
+            shader_release_stages(pending);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Separable mode version of shader_collect_program. Returns false after printing
+// the errors if a stage failed, the stages that succeeded are cached anyway.
+bool shader_collect_stages(PendingProgram *pending, BuildTimes *times) {
+    GLchar info[512] = {0};
+    bool success = true;
+
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        if (pending->reused[stage]) {
+            continue;
+        }
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(pending->stage_programs[stage], GL_LINK_STATUS, &linked);
+
+        if (linked) {
+            // Programs submitted together can build the same stage, the pipelines
+            // share the first one to finish.
+            pending->stage_programs[stage] = stage_program_add(pending->stage_keys[stage],
+                                                               pending->stage_programs[stage]);
+        } else {
+            glGetProgramInfoLog(pending->stage_programs[stage], 512, NULL, info);
+            printf("ERROR: %s shader compilation failed:\n", g_stage_names[stage]);
+            printf("%s\n", info);
+            glDeleteProgram(pending->stage_programs[stage]);
+            pending->stage_programs[stage] = 0;
+            success = false;
+        }
+    }
+
+    // Compiling and linking a stage is a single call.
+    times->compile_ns = metrics_now_ns() - pending->submit_ns;
+    return success;
+}
+
+// Starts compiling every stage and linking the program, without asking for any
+// status, so the driver is never waited on here. Stages found in the stage object
+// cache are linked without compiling them again. Returns false if the GL objects
+// could not be created.
+bool shader_submit_program(const StageSources *sources, PendingProgram *pending) {
+    memset(pending->shaders, 0, sizeof(pending->shaders));
+    memset(pending->reused, 0, sizeof(pending->reused));
+    pending->program = 0;
+    pending->submit_ns = metrics_now_ns();
+
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        pending->stage_keys[stage] = shader_stage_key(stage, sources);
+        pending->shaders[stage] = stage_object_find(pending->stage_keys[stage]);
+
+        if (pending->shaders[stage] != 0) {
+            pending->reused[stage] = true;
+            continue;
+        }
+
+        pending->shaders[stage] = glCreateShader(g_stage_types[stage]);
+
+        if (pending->shaders[stage] == 0) {
+            fprintf(stderr, "Error creating shaders (glCreateShader)\n");
+            shader_release_stages(pending);
+            return false;
+        }
+
+        glShaderSource(pending->shaders[stage], 4, &sources->strings[stage][0], NULL);
+        glCompileShader(pending->shaders[stage]);
+    }
+
+    // Linking can be issued right away, it fails if a stage did not compile.
+    pending->program = glCreateProgram();
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        glAttachShader(pending->program, pending->shaders[stage]);
+    }
+    shader_cache_prepare(pending->program);
+    glLinkProgram(pending->program);
+    return true;
+}
+
+// True once the driver finished the program, so querying it does not block. Without
+// KHR_parallel_shader_compile there is no way to know, and the query blocks.
+bool shader_program_completed(const PendingProgram *pending) {
+    if (!GLAD_GL_KHR_parallel_shader_compile) {
+        return true;
     }
 
-    GLuint program = 0;
+    // Variants are whole programs, also in separable mode.
+    bool separable = g_separable && pending->variant_key == 0;
+    GLint completed = GL_TRUE;
+    if (!separable) {
+        glGetProgramiv(pending->program, GL_COMPLETION_STATUS_KHR, &completed);
+    }
+    for (i32 stage = 0; stage < NUM_STAGES && separable && completed; stage++) {
+        if (!pending->reused[stage]) {
+            glGetProgramiv(pending->stage_programs[stage], GL_COMPLETION_STATUS_KHR, &completed);
+        }
+    }
+    return completed == GL_TRUE;
+}
 
+// Checks the results of a submitted program and releases its shader objects.
+// Returns the program, or 0 after printing the errors.
+GLuint shader_collect_program(PendingProgram *pending, BuildTimes *times) {
     // Stores information about the compilation, so we can print it,
     GLchar info[512] = {0};
-    GLint success;
+    GLint success = GL_TRUE;
+
+    u64 compile_start_ns = metrics_now_ns();
+    GLint compiled[NUM_STAGES];
+
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        glGetShaderiv(pending->shaders[stage], GL_COMPILE_STATUS, &compiled[stage]);
 
-    {
-        const char *vertex_string[3] = {
-            "#version 330 core\n",
-            "#define COMPILING_VERTEX\n",
-            shader_string->data
-        };
-        glShaderSource(vertex_shader, 3, &vertex_string[0], NULL);
+        if (!compiled[stage]) {
+            glGetShaderInfoLog(pending->shaders[stage], 512, NULL, info);
+            printf("ERROR: %s shader compilation failed:\n", g_stage_names[stage]);
+            printf("%s\n", info);
+            success = GL_FALSE;
+        }
     }
 
-    {
-        const char *fragment_string[3] = {
-            "#version 330 core\n",
-            "#define COMPILING_FRAGMENT\n",
-            shader_string->data
-        };
-        glShaderSource(fragment_shader, 3, &fragment_string[0], NULL);
+    u64 link_start_ns = metrics_now_ns();
+
+    if (success) {
+        glGetProgramiv(pending->program, GL_LINK_STATUS, &success);
+
+        if (!success) {
+            glGetProgramInfoLog(pending->program, 512, NULL, info);
+            printf("ERROR: Shader linking failed:\n");
+            printf("%s\n", info);
+        }
     }
 
-    //printf("CODE:\n%s\n", shader_string->data);
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        // Everything ran on the driver threads, only the whole time is known.
+        times->compile_ns = link_start_ns - pending->submit_ns;
+    } else {
+        // The status queries waited for the compiler and the linker.
+        times->compile_ns = link_start_ns - compile_start_ns;
+        times->link_ns = metrics_now_ns() - link_start_ns;
+    }
 
-    /* Debug("Compiling vertex shader ... "); */
-    glCompileShader(vertex_shader);
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
+    // Stages that compiled are kept even when the link failed, the next edit most
+    // likely only touches the other stage.
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        if (pending->reused[stage]) {
+            continue;
+        }
+        if (compiled[stage]) {
+            pending->shaders[stage] = stage_object_add(pending->stage_keys[stage],
+                                                       pending->shaders[stage]);
+        } else {
+            glDeleteShader(pending->shaders[stage]);
+        }
+    }
 
     if (!success) {
-        glGetShaderInfoLog(vertex_shader, 512, NULL, info);
-        printf("ERROR: Vertex shader compilation failed:\n");
-        printf("%s\n", info);
-        goto error_cleanup;
+        glDeleteProgram(pending->program);
+        return 0;
     }
-    /* printf("done\n"); */
 
-    /* Debug("Compiling fragment shader ... "); */
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
+    shader_cache_store(pending->cache_key, pending->program);
+    return pending->program;
+}
 
-    if (!success) {
-        glGetShaderInfoLog(fragment_shader, 512, NULL, info);
-        printf("ERROR: Fragment shader compilation failed:\n");
-        printf("%s\n", info);
-        goto error_cleanup;
+// Records the times of a build, skipping the stages it did not go through.
+void shader_record_build_times(const BuildTimes *times) {
+    if (times->compile_ns != 0) {
+        metrics_record(MetricsStage_Compile, times->compile_ns);
+    }
+    if (times->link_ns != 0) {
+        metrics_record(MetricsStage_Link, times->link_ns);
     }
-    /* printf("done\n"); */
+    if (times->cache_load_ns != 0) {
+        metrics_record(MetricsStage_CacheLoad, times->cache_load_ns);
+    }
+}
 
-    program = glCreateProgram();
-    /* Debug("Linking shader program ... "); */
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
+isize shader_count() {
+    return g_shaders ? array_length(g_shaders) : 0;
+}
 
-    if (!success) {
-        glGetShaderInfoLog(fragment_shader, 512, NULL, info);
-        printf("ERROR: Shader linking failed:\n");
-        printf("%s\n", info);
-        goto error_cleanup;
+ShaderId shader_find(const char *name) {
+    for (isize id = 0; id < shader_count(); id++) {
+        if (strcmp(g_shaders[id].name->data, name) == 0) {
+            return (ShaderId)id;
+        }
     }
-    /* printf("done\n\n"); */
+    return SHADER_INVALID_ID;
+}
 
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
-    string_free(shader_string);
-    string_free(shader_src_path);
-    return program;
+const char *shader_get_name(ShaderId id) {
+    LT_ASSERT(id >= 0 && id < shader_count());
+    return g_shaders[id].name->data;
+}
 
-error_cleanup:
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
-    string_free(shader_string);
-    string_free(shader_src_path);
-    return 0;
+GLuint shader_get_program(ShaderId id) {
+    LT_ASSERT(id >= 0 && id < shader_count());
+    return g_shaders[id].program;
+}
+
+void shader_bind(ShaderId id) {
+    LT_ASSERT(id >= 0 && id < shader_count());
+    if (g_separable) {
+        glBindProgramPipeline(g_shaders[id].pipeline);
+    } else {
+        glUseProgram(g_shaders[id].program);
+    }
+}
+
+void shader_unbind() {
+    glUseProgram(0);
+    if (g_separable) {
+        glBindProgramPipeline(0);
+    }
+}
+
+void source_table_init(SourceTable *t, isize capacity) {
+    LT_ASSERT((capacity & (capacity - 1)) == 0);
+
+    t->entries = calloc(capacity, sizeof(ShaderSource));
+    t->capacity = capacity;
+    t->count = 0;
+}
+
+// Returns the entry of path, relative to the resources folder. When it does not exist
+// yet it is created if create is true, otherwise NULL is returned.
+ShaderSource *source_table_get(SourceTable *t, const char *path, bool create) {
+    isize len = (isize)strlen(path);
+    u64 hash = lt_hash64(path, len, 0);
+    isize mask = t->capacity - 1;
+    isize i = (isize)(hash & (u64)mask);
+
+    for (; t->entries[i].path != NULL; i = (i + 1) & mask) {
+        ShaderSource *e = &t->entries[i];
+        if (e->hash == hash && e->path->len == len && memcmp(e->path->data, path, len) == 0) {
+            return e;
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    // Keep the load factor under 1/2.
+    if ((t->count + 1) * 2 > t->capacity) {
+        SourceTable grown;
+        source_table_init(&grown, t->capacity * 2);
+
+        for (isize j = 0; j < t->capacity; j++) {
+            if (t->entries[j].path != NULL) {
+                isize k = (isize)(t->entries[j].hash & (u64)(grown.capacity - 1));
+                while (grown.entries[k].path != NULL) {
+                    k = (k + 1) & (grown.capacity - 1);
+                }
+                grown.entries[k] = t->entries[j];
+                grown.count++;
+            }
+        }
+        lt_free(t->entries);
+        *t = grown;
+
+        mask = t->capacity - 1;
+        i = (isize)(hash & (u64)mask);
+        while (t->entries[i].path != NULL) {
+            i = (i + 1) & mask;
+        }
+    }
+
+    ShaderSource *e = &t->entries[i];
+    e->hash = hash;
+    e->path = string_make(path);
+    // Source strings 0 to 2 are the version and the defines, see shader_stage_sources.
+    e->id = (i32)t->count + 3;
+    array_init(e->dependents);
+    array_init(e->includes);
+    array_init(e->includers);
+    t->count++;
+    return e;
+}
+
+// Records that the program of id is built from path. Returns false if it already was.
+bool shader_add_dependency(ShaderId id, const char *path) {
+    ShaderSource *source = source_table_get(&g_sources, path, true);
+
+    for (isize i = 0; i < array_length(source->dependents); i++) {
+        if (source->dependents[i] == id) {
+            return false;
+        }
+    }
+    array_append(source->dependents, id);
+    return true;
+}
+
+// Records that the program of id is built from path and every file it includes.
+void shader_add_dependency_tree(ShaderId id, const char *path) {
+    if (!shader_add_dependency(id, path)) {
+        return;
+    }
+
+    ShaderSource *source = source_table_get(&g_sources, path, false);
+    for (isize i = 0; i < array_length(source->includes); i++) {
+        shader_add_dependency_tree(id, source->includes[i]->data);
+    }
 }
 
-GLuint shader_get_program(ShaderKind kind) {
-    return g_shaders[kind].program;
+// Forgets every source the program of id was built from.
+void shader_clear_dependencies(ShaderId id) {
+    for (isize i = 0; i < g_sources.capacity; i++) {
+        ShaderSource *source = &g_sources.entries[i];
+        if (source->path == NULL) {
+            continue;
+        }
+
+        for (isize j = 0; j < array_length(source->dependents); j++) {
+            if (source->dependents[j] == id) {
+                source->dependents[j] = source->dependents[--array_length(source->dependents)];
+                break;
+            }
+        }
+    }
+}
+
+// Returns the length of the next whitespace separated word of the line.
+isize manifest_word(const char *line, const char *end) {
+    isize len = 0;
+    while (line + len < end && line[len] != ' ' && line[len] != '\t') {
+        len++;
+    }
+    return len;
+}
+
+const char *manifest_skip_blanks(const char *line, const char *end) {
+    while (line < end && (*line == ' ' || *line == '\t' || *line == '\r')) {
+        line++;
+    }
+    return line;
+}
+
+// Records a variant line of the manifest. The shader has to be listed above it.
+void shader_add_manifest_variant(const char *name, isize name_len, const char *defines,
+                                 const char *line_end, const char *manifest_path, i32 line_number) {
+    while (line_end > defines && (line_end[-1] == '\r' || line_end[-1] == ' ' || line_end[-1] == '\t')) {
+        line_end--;
+    }
+
+    String *shader_name = string_make_ptrs((u8*)name, (u8*)name + name_len - 1);
+    ManifestVariant variant = {0};
+    variant.id = shader_find(shader_name->data);
+
+    if (variant.id == SHADER_INVALID_ID) {
+        fprintf(stderr, "%s:%d: no shader %s above the variant, IGNORING.\n",
+                manifest_path, line_number, shader_name->data);
+    } else if (defines == line_end) {
+        fprintf(stderr, "%s:%d: expected `variant <name> <define>[=<value>]...`, IGNORING.\n",
+                manifest_path, line_number);
+    } else {
+        variant.defines = string_make_ptrs((u8*)defines, (u8*)line_end - 1);
+        array_append(g_manifest_variants, variant);
+    }
+    string_free(shader_name);
 }
 
-void shader_recompile(ShaderKind kind) {
-    switch (kind) {
-    case ShaderKind_Basic: {
-        printf("Recompiling Basic Shader\n");
-        GLuint old_program = g_shaders[kind].program;
-        GLuint new_program = shader_make_program("basic.glsl");
+// Adds the shaders of the manifest that are not registered yet, and updates the
+// source of the others. Every added or changed shader is marked dirty. Returns false
+// if the manifest could not be read.
+bool shader_load_manifest() {
+    String *manifest_path = string_make(resources_path);
+    string_append(manifest_path, manifest_file);
+    FileContents *manifest = file_read_contents(manifest_path->data);
+
+    if (manifest->error != FileError_None) {
+        fprintf(stderr, "Error reading shader manifest %s\n", manifest_path->data);
+        file_free_contents(manifest);
+        string_free(manifest_path);
+        return false;
+    }
+
+    for (isize i = 0; i < array_length(g_manifest_variants); i++) {
+        string_free(g_manifest_variants[i].defines);
+    }
+    array_length(g_manifest_variants) = 0;
+
+    // One shader per line: `<name> <file>`, or one of its variants:
+    // `variant <name> <define>[=<value>]...`. Lines starting with `#` are comments.
+    const char *cursor = manifest->data;
+    const char *end = cursor + manifest->size;
+    i32 line_number = 0;
+
+    while (cursor < end) {
+        const char *line_end = memchr(cursor, '\n', end - cursor);
+        line_end = line_end ? line_end : end;
+        line_number++;
+
+        const char *name = manifest_skip_blanks(cursor, line_end);
+        isize name_len = manifest_word(name, line_end);
+        const char *file = manifest_skip_blanks(name + name_len, line_end);
+        isize file_len = manifest_word(file, line_end);
+        const char *rest = manifest_skip_blanks(file + file_len, line_end);
+        cursor = line_end + 1;
+
+        if (name_len == 0 || name[0] == '#') {
+            continue;
+        }
+        if (name_len == 7 && strncmp(name, "variant", 7) == 0) {
+            shader_add_manifest_variant(file, file_len, rest, line_end, manifest_path->data, line_number);
+            continue;
+        }
+        while (file_len > 0 && file[file_len - 1] == '\r') {
+            file_len--;
+        }
+        if (file_len == 0 || rest != line_end) {
+            fprintf(stderr, "%s:%d: expected `<name> <file>`, IGNORING.\n",
+                    manifest_path->data, line_number);
+            continue;
+        }
+
+        String *shader_name = string_make_ptrs((u8*)name, (u8*)name + name_len - 1);
+        String *shader_file = string_make_ptrs((u8*)file, (u8*)file + file_len - 1);
+        ShaderId id = shader_find(shader_name->data);
+
+        if (id == SHADER_INVALID_ID) {
+            Shader shader = {0};
+            shader.name = shader_name;
+            shader.file = shader_file;
+            shader.dirty = true;
+            array_append(g_shaders, shader);
+            id = (ShaderId)(array_length(g_shaders) - 1);
+        } else if (strcmp(g_shaders[id].file->data, shader_file->data) != 0) {
+            string_free(g_shaders[id].file);
+            g_shaders[id].file = shader_file;
+            g_shaders[id].dirty = true;
+            string_free(shader_name);
+            shader_clear_dependencies(id);
+        } else {
+            string_free(shader_name);
+            string_free(shader_file);
+        }
+
+        shader_add_dependency(id, g_shaders[id].file->data);
+    }
+
+    file_free_contents(manifest);
+    string_free(manifest_path);
+    return true;
+}
 
-        if (new_program == 0) {
+// Removes the path from an array of paths, if it is there.
+void path_array_remove(Array(const String *) paths, const String *path) {
+    for (isize i = 0; i < array_length(paths); i++) {
+        if (paths[i] == path) {
+            paths[i] = paths[--array_length(paths)];
             return;
         }
+    }
+}
+
+// Resolves an include relative to the folder of the including file, and removes `.`
+// and `..` segments, so every file has a single entry. Returns false if the result
+// is outside the resources folder or too long.
+bool include_resolve(const char *including_file, const char *include, isize include_len,
+                     char *out, isize out_size) {
+    const char *slash = strrchr(including_file, '/');
+    isize dir_len = slash ? slash - including_file + 1 : 0;
+
+    char joined[MAX_SOURCE_PATH];
+    if (dir_len + include_len >= (isize)sizeof(joined)) {
+        return false;
+    }
+    memcpy(joined, including_file, dir_len);
+    memcpy(joined + dir_len, include, include_len);
+    joined[dir_len + include_len] = '\0';
 
-        g_shaders[kind].program = new_program;
-        glDeleteProgram(old_program);
-    } break;
+    isize len = 0;
+    const char *segment = joined;
 
-    default:
-        LT_ASSERT(false);
+    while (*segment) {
+        const char *segment_end = strchr(segment, '/');
+        isize segment_len = segment_end ? segment_end - segment : (isize)strlen(segment);
+
+        if (segment_len == 0 || (segment_len == 1 && segment[0] == '.')) {
+            // Nothing to add.
+        } else if (segment_len == 2 && segment[0] == '.' && segment[1] == '.') {
+            if (len == 0) {
+                return false;
+            }
+            // Back to the end of the previous segment.
+            while (len > 0 && out[len - 1] != '/') {
+                len--;
+            }
+            len = len > 0 ? len - 1 : 0;
+        } else {
+            if (len + segment_len + 2 > out_size) {
+                return false;
+            }
+            if (len > 0) {
+                out[len++] = '/';
+            }
+            memcpy(out + len, segment, segment_len);
+            len += segment_len;
+        }
+
+        segment += segment_len;
+        if (*segment == '/') {
+            segment++;
+        }
     }
+
+    out[len] = '\0';
+    return len > 0;
 }
 
-void shader_initialize() {
-    Shader basic_shader;
-    basic_shader.program = shader_make_program("basic.glsl");
+// Returns true if the line is an #include directive, and stores the included name.
+// A malformed directive is an error, reported through malformed.
+bool include_parse(const char *line, const char *line_end,
+                   const char **name, isize *name_len, bool *malformed) {
+    const char *c = line;
+    *malformed = false;
+
+    while (c < line_end && (*c == ' ' || *c == '\t')) { c++; }
+    if (c == line_end || *c != '#') {
+        return false;
+    }
+    c++;
+    while (c < line_end && (*c == ' ' || *c == '\t')) { c++; }
+
+    const isize directive_len = sizeof("include") - 1;
+    if (line_end - c < directive_len || strncmp(c, "include", directive_len) != 0) {
+        return false;
+    }
+    c += directive_len;
+    while (c < line_end && (*c == ' ' || *c == '\t')) { c++; }
+
+    const char *close = c < line_end && *c == '"' ? memchr(c + 1, '"', line_end - c - 1) : NULL;
+    if (close == NULL || close == c + 1) {
+        *malformed = true;
+        return true;
+    }
+
+    *name = c + 1;
+    *name_len = close - c - 1;
+    return true;
+}
+
+// Returns the contents of path with every #include replaced by the expansion of the
+// included file. Expansions are cached, only files that changed since they were
+// expanded are read again. Returns NULL after printing the error, when a file is
+// missing or the includes are malformed or cyclic.
+const String *shader_expand(const char *path, i32 depth) {
+    ShaderSource *source = source_table_get(&g_sources, path, true);
+
+    if (source->expanded != NULL) {
+        return source->expanded;
+    }
+    if (source->expanding || depth > MAX_INCLUDE_DEPTH) {
+        fprintf(stderr, "ERROR: %s includes itself\n", path);
+        return NULL;
+    }
+
+    String *contents = shader_read_source(path);
+    if (contents == NULL) {
+        return NULL;
+    }
+
+    // Expanding the includes can grow the table and move its entries, so the entry
+    // is looked up again by its path afterwards.
+    const String *source_path = source->path;
+    i32 source_id = source->id;
+    source->expanding = true;
+
+    // The includes are found again, forget the old ones.
+    for (isize i = 0; i < array_length(source->includes); i++) {
+        ShaderSource *included = source_table_get(&g_sources, source->includes[i]->data, false);
+        path_array_remove(included->includers, source_path);
+    }
+    array_length(source->includes) = 0;
+
+    String *expanded = string_make("");
+    char directive[64];
+    snprintf(directive, sizeof(directive), "#line 1 %d\n", source_id);
+    string_append_length(expanded, directive, strlen(directive));
+
+    const char *line = contents->data;
+    const char *end = contents->data + contents->len;
+    i32 line_number = 0;
+    bool failed = false;
+
+    while (line < end && !failed) {
+        const char *line_end = memchr(line, '\n', end - line);
+        line_end = line_end ? line_end : end;
+        line_number++;
+
+        const char *name;
+        isize name_len;
+        bool malformed;
+
+        if (!include_parse(line, line_end, &name, &name_len, &malformed)) {
+            string_append_length(expanded, line, line_end - line);
+            string_append_length(expanded, "\n", 1);
+            line = line_end + 1;
+            continue;
+        }
+
+        char include_path[MAX_SOURCE_PATH];
+        if (malformed || !include_resolve(source_path->data, name, name_len,
+                                          include_path, sizeof(include_path))) {
+            fprintf(stderr, "ERROR: %s:%d: invalid #include\n", source_path->data, line_number);
+            failed = true;
+            break;
+        }
+
+        // The edge is recorded even if the included file is broken, so fixing it
+        // recompiles this file as well.
+        const String *included_path = source_table_get(&g_sources, include_path, true)->path;
+        source = source_table_get(&g_sources, source_path->data, false);
+        ShaderSource *included = source_table_get(&g_sources, include_path, false);
+
+        bool known = false;
+        for (isize i = 0; i < array_length(source->includes); i++) {
+            known |= source->includes[i] == included_path;
+        }
+        if (!known) {
+            array_append(source->includes, included_path);
+            array_append(included->includers, source_path);
+        }
+
+        const String *included_text = shader_expand(included_path->data, depth + 1);
+        if (included_text == NULL) {
+            fprintf(stderr, "  included from %s:%d\n", source_path->data, line_number);
+            failed = true;
+            break;
+        }
+
+        string_append_length(expanded, included_text->data, included_text->len);
+        if (included_text->len > 0 && included_text->data[included_text->len - 1] != '\n') {
+            string_append_length(expanded, "\n", 1);
+        }
+        snprintf(directive, sizeof(directive), "#line %d %d\n", line_number + 1, source_id);
+        string_append_length(expanded, directive, strlen(directive));
+        line = line_end + 1;
+    }
+
+    string_free(contents);
+    source = source_table_get(&g_sources, source_path->data, false);
+    source->expanding = false;
+
+    if (failed) {
+        string_free(expanded);
+        return NULL;
+    }
+
+    source->expanded = expanded;
+    return expanded;
+}
+
+// Drops the cached expansion of the file and of every file including it.
+void shader_invalidate_expansion(ShaderSource *source) {
+    // Files including this one can only have an expansion if this one has one.
+    if (source->expanded == NULL) {
+        return;
+    }
+
+    string_free(source->expanded);
+    source->expanded = NULL;
+
+    for (isize i = 0; i < array_length(source->includers); i++) {
+        shader_invalidate_expansion(source_table_get(&g_sources, source->includers[i]->data, false));
+    }
+}
+
+bool shader_file_changed(const char *path) {
+    // Paths from the watcher are absolute, the index is relative to the resources.
+    isize prefix_len = (isize)strlen(resources_path);
+    if (strncmp(path, resources_path, prefix_len) == 0) {
+        path += prefix_len;
+    }
+
+    // New shaders are registered as soon as the manifest is saved.
+    if (strcmp(path, manifest_file) == 0) {
+        return shader_load_manifest();
+    }
+
+    ShaderSource *source = source_table_get(&g_sources, path, false);
+    if (source == NULL) {
+        return false;
+    }
+
+    shader_invalidate_expansion(source);
+
+    if (array_length(source->dependents) == 0) {
+        return false;
+    }
+
+    for (isize i = 0; i < array_length(source->dependents); i++) {
+        g_shaders[source->dependents[i]].dirty = true;
+    }
+    return true;
+}
+
+// Replaces the program of the shader with a new one.
+void shader_swap_program(ShaderId id, GLuint program, u64 source_hash) {
+    u64 swap_start_ns = metrics_now_ns();
+    Shader *shader = &g_shaders[id];
+    GLuint old_program = shader->program;
+
+    shader->program = program;
+    shader->source_hash = source_hash;
+    glDeleteProgram(old_program);
+    metrics_record(MetricsStage_Swap, metrics_now_ns() - swap_start_ns);
+    metrics_reload_swapped();
+}
+
+// Replaces the stages of the pipeline of the shader that changed. Nothing is linked,
+// the pipeline just points at the new stage programs.
+void shader_swap_stages(ShaderId id, const GLuint stage_programs[NUM_STAGES], u64 source_hash) {
+    u64 swap_start_ns = metrics_now_ns();
+    Shader *shader = &g_shaders[id];
+
+    if (shader->pipeline == 0) {
+        glGenProgramPipelines(1, &shader->pipeline);
+    }
+
+    for (i32 stage = 0; stage < NUM_STAGES; stage++) {
+        if (stage_programs[stage] == shader->stage_programs[stage]) {
+            continue;
+        }
+        glUseProgramStages(shader->pipeline, g_stage_bits[stage], stage_programs[stage]);
+        stage_program_ref(stage_programs[stage], 1);
+        stage_program_ref(shader->stage_programs[stage], -1);
+        shader->stage_programs[stage] = stage_programs[stage];
+    }
+
+    shader->source_hash = source_hash;
+    metrics_record(MetricsStage_Swap, metrics_now_ns() - swap_start_ns);
+    metrics_reload_swapped();
+}
+
+ShaderVariant *variant_find(u64 key) {
+    for (isize i = 0; i < array_length(g_variants); i++) {
+        if (g_variants[i].key == key) {
+            return &g_variants[i];
+        }
+    }
+    return NULL;
+}
+
+// Bytes of the program as reported by the driver, or an estimate.
+u64 shader_program_size(GLuint program) {
+    GLint length = 0;
+    if (GLAD_GL_ARB_get_program_binary) {
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    }
+    return length > 0 ? (u64)length : VARIANT_ESTIMATED_SIZE;
+}
+
+// Replaces the program of the variant with a new one, or only records the source
+// it was built from when the build failed, so it is not retried until it changes.
+void shader_swap_variant(ShaderVariant *variant, GLuint program, u64 source_hash) {
+    variant->source_hash = source_hash;
+    if (program == 0) {
+        return;
+    }
+
+    glDeleteProgram(variant->program);
+    g_variant_bytes -= variant->size;
+    variant->program = program;
+    variant->size = shader_program_size(program);
+    g_variant_bytes += variant->size;
+}
+
+// Deletes the least recently requested variants until their programs fit in the
+// budget. Variants being built are kept.
+void shader_evict_variants() {
+    while (g_variant_bytes > g_variant_budget) {
+        isize oldest = -1;
+        for (isize i = 0; i < array_length(g_variants); i++) {
+            if (g_variants[i].program != 0 && g_variants[i].building_hash == 0 &&
+                (oldest < 0 || g_variants[i].last_used < g_variants[oldest].last_used)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            return;
+        }
+
+        glDeleteProgram(g_variants[oldest].program);
+        g_variant_bytes -= g_variants[oldest].size;
+        string_free(g_variants[oldest].defines);
+        string_free(g_variants[oldest].label);
+        g_variants[oldest] = g_variants[array_length(g_variants) - 1];
+        array_length(g_variants)--;
+    }
+}
+
+// Hash of the source being built for the shader or one of its variants, NULL if
+// the variant was evicted meanwhile.
+u64 *shader_building_hash(ShaderId id, u64 variant_key) {
+    if (variant_key == 0) {
+        return &g_shaders[id].building_hash;
+    }
+    ShaderVariant *variant = variant_find(variant_key);
+    return variant ? &variant->building_hash : NULL;
+}
+
+// Records the times of a finished build. When precompiling it is also reported.
+void shader_build_done(ShaderId id, u64 variant_key, const BuildTimes *times, bool success) {
+    shader_record_build_times(times);
+    // The old program stays, the reload waiting for it never ends.
+    if (!success && variant_key == 0) {
+        metrics_reload_cancel();
+    }
+    if (!g_precompiling) {
+        return;
+    }
+
+    ShaderVariant *variant = variant_key != 0 ? variant_find(variant_key) : NULL;
+    g_num_builds++;
+    g_failed_builds += success ? 0 : 1;
+
+    printf("  %-16s %-32s ", g_shaders[id].name->data, variant ? variant->label->data : "");
+    if (!success) {
+        printf("FAILED\n");
+    } else if (times->cache_load_ns != 0) {
+        printf("cache load %8.2f ms\n", times->cache_load_ns / 1e6);
+    } else if (times->link_ns == 0) {
+        // The driver compiled and linked on its own threads.
+        printf("compile and link %8.2f ms\n", times->compile_ns / 1e6);
+    } else {
+        printf("compile %8.2f ms  link %8.2f ms\n", times->compile_ns / 1e6, times->link_ns / 1e6);
+    }
+}
+
+// Checks the results of a pending program the driver is done with, and swaps it in.
+void shader_apply_pending(PendingProgram *pending) {
+    BuildTimes times = {0};
+
+    if (pending->variant_key != 0) {
+        GLuint program = shader_collect_program(pending, &times);
+        shader_build_done(pending->id, pending->variant_key, &times, program != 0);
+
+        ShaderVariant *variant = variant_find(pending->variant_key);
+        if (variant == NULL || variant->building_hash != pending->source_hash) {
+            glDeleteProgram(program);
+            return;
+        }
+        variant->building_hash = 0;
+        shader_swap_variant(variant, program, pending->source_hash);
+        return;
+    }
+
+    if (g_separable) {
+        bool success = shader_collect_stages(pending, &times);
+        shader_build_done(pending->id, 0, &times, success);
+        if (success) {
+            shader_swap_stages(pending->id, pending->stage_programs, pending->source_hash);
+        }
+        stage_program_trim();
+        return;
+    }
+
+    GLuint program = shader_collect_program(pending, &times);
+    shader_build_done(pending->id, 0, &times, program != 0);
+    if (program != 0) {
+        shader_swap_program(pending->id, program, pending->source_hash);
+    }
+}
+
+// Drops the pending program at index i, keeping the order of the others.
+void shader_discard_pending(isize i) {
+    PendingProgram *pending = &g_pending[i];
+
+    shader_release_stages(pending);
+    glDeleteProgram(pending->program);
+
+    memmove(&g_pending[i], &g_pending[i+1], sizeof(PendingProgram) * (array_length(g_pending) - i - 1));
+    array_length(g_pending)--;
+}
+
+// Builds the program of a job, from the cache when possible. Runs on the compile
+// thread, so it waits for the driver.
+void shader_build_job(CompileJob *job) {
+    StageSources sources;
+    shader_stage_sources(job->source, job->defines ? job->defines->data : "", &sources);
+
+    PendingProgram pending = {0};
+    pending.id = job->id;
+    pending.source_hash = job->source_hash;
+    pending.cache_key = shader_program_cache_key(&sources);
+
+    u64 load_start_ns = metrics_now_ns();
+    job->program = shader_cache_load(pending.cache_key);
+    if (job->program != 0) {
+        job->times.cache_load_ns = metrics_now_ns() - load_start_ns;
+    } else if (shader_submit_program(&sources, &pending)) {
+        job->program = shader_collect_program(&pending, &job->times);
+    }
+    shader_free_stage_sources(&sources);
+}
+
+void *shader_compile_thread(void *arg) {
+    LT_UNUSED(arg);
+    glfwMakeContextCurrent(g_compile_context);
+
+    pthread_mutex_lock(&g_compile_mutex);
+    while (!g_compile_quit) {
+        if (array_length(g_compile_jobs) == 0) {
+            pthread_cond_wait(&g_compile_cond, &g_compile_mutex);
+            continue;
+        }
+
+        CompileJob job = g_compile_jobs[0];
+        memmove(&g_compile_jobs[0], &g_compile_jobs[1], sizeof(CompileJob) * (array_length(g_compile_jobs) - 1));
+        array_length(g_compile_jobs)--;
+        pthread_mutex_unlock(&g_compile_mutex);
+
+        shader_build_job(&job);
+        string_free(job.source);
+        if (job.defines != NULL) {
+            string_free(job.defines);
+        }
+        job.source = NULL;
+        job.defines = NULL;
+
+        if (job.program != 0) {
+            job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        // The fence is only ever signaled once it reached the GPU.
+        glFlush();
+
+        pthread_mutex_lock(&g_compile_mutex);
+        array_append(g_compile_results, job);
+        pthread_cond_signal(&g_compile_done_cond);
+    }
+    pthread_mutex_unlock(&g_compile_mutex);
+
+    glfwMakeContextCurrent(NULL);
+    return NULL;
+}
+
+// Hands the source to the compile thread, with the defines of the variant, or NULL
+// for the program of the shader. A job of the same program still waiting in the
+// queue is given the new source instead.
+void shader_queue_compile(ShaderId id, u64 variant_key, const String *defines,
+                          const String *shader_string, u64 source_hash) {
+    *shader_building_hash(id, variant_key) = source_hash;
+
+    pthread_mutex_lock(&g_compile_mutex);
+    for (isize i = 0; i < array_length(g_compile_jobs); i++) {
+        if (g_compile_jobs[i].id == id && g_compile_jobs[i].variant_key == variant_key) {
+            string_free(g_compile_jobs[i].source);
+            g_compile_jobs[i].source = string_make(shader_string->data);
+            g_compile_jobs[i].source_hash = source_hash;
+            pthread_mutex_unlock(&g_compile_mutex);
+            return;
+        }
+    }
+
+    CompileJob job = {0};
+    job.id = id;
+    job.variant_key = variant_key;
+    job.source_hash = source_hash;
+    job.source = string_make(shader_string->data);
+    job.defines = defines ? string_make(defines->data) : NULL;
+    array_append(g_compile_jobs, job);
+    pthread_cond_signal(&g_compile_cond);
+    pthread_mutex_unlock(&g_compile_mutex);
+}
+
+// Drops the queued job of the program of the shader. A build already running is
+// dropped when it is handed back.
+void shader_cancel_compile(ShaderId id) {
+    g_shaders[id].building_hash = 0;
+
+    pthread_mutex_lock(&g_compile_mutex);
+    for (isize i = 0; i < array_length(g_compile_jobs); i++) {
+        if (g_compile_jobs[i].id == id && g_compile_jobs[i].variant_key == 0) {
+            string_free(g_compile_jobs[i].source);
+            memmove(&g_compile_jobs[i], &g_compile_jobs[i+1], sizeof(CompileJob) * (array_length(g_compile_jobs) - i - 1));
+            array_length(g_compile_jobs)--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_compile_mutex);
+}
+
+// Swaps in the programs built by the compile thread whose fence is signaled. With
+// wait set, it waits for the fences instead of leaving them for the next frame.
+void shader_collect_compiled(bool wait) {
+    pthread_mutex_lock(&g_compile_mutex);
+
+    isize i = 0;
+    while (i < array_length(g_compile_results)) {
+        CompileJob *job = &g_compile_results[i];
+        u64 *building_hash = shader_building_hash(job->id, job->variant_key);
+        bool current = building_hash != NULL && job->source_hash == *building_hash;
+
+        if (current && job->fence != NULL) {
+            GLenum status = glClientWaitSync(job->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                             wait ? GL_TIMEOUT_IGNORED : 0);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                i++;
+                continue;
+            }
+        }
+
+        if (job->fence != NULL) {
+            glDeleteSync(job->fence);
+        }
+
+        if (current) {
+            *building_hash = 0;
+            shader_build_done(job->id, job->variant_key, &job->times, job->program != 0);
+            // The program is bound again by every draw, which is what makes the
+            // changes of the other context visible to this one.
+            if (job->variant_key != 0) {
+                shader_swap_variant(variant_find(job->variant_key), job->program, job->source_hash);
+            } else if (job->program != 0) {
+                shader_swap_program(job->id, job->program, job->source_hash);
+            }
+        } else {
+            glDeleteProgram(job->program);
+        }
+
+        memmove(&g_compile_results[i], &g_compile_results[i+1], sizeof(CompileJob) * (array_length(g_compile_results) - i - 1));
+        array_length(g_compile_results)--;
+    }
+
+    pthread_mutex_unlock(&g_compile_mutex);
+}
+
+// True while the compile thread has a build that was not swapped in yet.
+bool shader_compiling() {
+    for (isize id = 0; id < shader_count(); id++) {
+        if (g_shaders[id].building_hash != 0) {
+            return true;
+        }
+    }
+    for (isize i = 0; i < array_length(g_variants); i++) {
+        if (g_variants[i].building_hash != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool shader_recompile(ShaderId id) {
+    LT_ASSERT(id >= 0 && id < shader_count());
+    Shader *shader = &g_shaders[id];
+
+    shader->dirty = false;
+
+    u64 read_start_ns = metrics_now_ns();
+    const String *shader_string = shader_expand(shader->file->data, 0);
+
+    // The includes may have changed, even when the expansion failed.
+    shader_clear_dependencies(id);
+    shader_add_dependency_tree(id, shader->file->data);
+
+    BuildTimes times = {0};
+    if (shader_string == NULL) {
+        shader_build_done(id, 0, &times, false);
+        return false;
+    }
+    metrics_record(MetricsStage_SourceRead, metrics_now_ns() - read_start_ns);
+
+    u64 source_hash = shader_hash_source(shader_string);
+    shader->expanded_hash = source_hash;
+
+    // A newer source replaces the one being compiled, the same one keeps compiling.
+    bool dropped = false;
+    for (isize i = 0; i < array_length(g_pending); i++) {
+        if (g_pending[i].id != id || g_pending[i].variant_key != 0) {
+            continue;
+        }
+        if (g_pending[i].source_hash == source_hash) {
+            return false;
+        }
+        shader_discard_pending(i);
+        dropped = true;
+        break;
+    }
+
+    if (g_compile_context != NULL && shader->building_hash == source_hash) {
+        return false;
+    }
+
+    if ((shader->program != 0 || shader->pipeline != 0) && shader->source_hash == source_hash) {
+        printf("Source of %s is unchanged, skipping recompile\n", shader->name->data);
+        // The edit was undone while the compile thread was building it.
+        if (g_compile_context != NULL && shader->building_hash != 0) {
+            shader_cancel_compile(id);
+            dropped = true;
+        }
+        // Nothing is swapped in for the reload of the dropped build.
+        if (dropped) {
+            metrics_reload_cancel();
+        }
+        return false;
+    }
+
+    if (g_compile_context != NULL) {
+        printf("Recompiling %s on the compile thread\n", shader->name->data);
+        shader_queue_compile(id, 0, NULL, shader_string, source_hash);
+        return true;
+    }
+
+    StageSources sources;
+    shader_stage_sources(shader_string, "", &sources);
+    bool started = true;
+
+    PendingProgram pending = {0};
+    pending.id = id;
+    pending.source_hash = source_hash;
+    pending.cache_key = shader_program_cache_key(&sources);
+
+    // Only whole programs are kept in the binary cache.
+    u64 load_start_ns = metrics_now_ns();
+    GLuint cached_program = g_separable ? 0 : shader_cache_load(pending.cache_key);
+    if (cached_program != 0) {
+        printf("Loaded %s from the shader cache\n", shader->name->data);
+        times.cache_load_ns = metrics_now_ns() - load_start_ns;
+        shader_build_done(id, 0, &times, true);
+        shader_swap_program(id, cached_program, source_hash);
+    } else {
+        printf("Recompiling %s\n", shader->name->data);
+        bool submitted = g_separable ? shader_submit_stages(&sources, &pending)
+                                     : shader_submit_program(&sources, &pending);
+        if (submitted) {
+            array_append(g_pending, pending);
+        } else {
+            shader_build_done(id, 0, &times, false);
+            started = false;
+        }
+    }
+    shader_free_stage_sources(&sources);
+    return started;
+}
+
+void shader_update() {
+    g_frame++;
+
+    if (g_compile_context != NULL) {
+        shader_collect_compiled(false);
+    }
+
+    isize i = 0;
+
+    while (i < array_length(g_pending)) {
+        if (!shader_program_completed(&g_pending[i])) {
+            i++;
+            continue;
+        }
+
+        PendingProgram pending = g_pending[i];
+        memmove(&g_pending[i], &g_pending[i+1], sizeof(PendingProgram) * (array_length(g_pending) - i - 1));
+        array_length(g_pending)--;
+
+        shader_apply_pending(&pending);
+    }
+
+    shader_evict_variants();
+}
+
+void shader_finish() {
+    while (g_compile_context != NULL && shader_compiling()) {
+        pthread_mutex_lock(&g_compile_mutex);
+        while (array_length(g_compile_results) == 0) {
+            pthread_cond_wait(&g_compile_done_cond, &g_compile_mutex);
+        }
+        pthread_mutex_unlock(&g_compile_mutex);
+
+        shader_collect_compiled(true);
+    }
+
+    while (array_length(g_pending) > 0) {
+        PendingProgram pending = g_pending[0];
+        memmove(&g_pending[0], &g_pending[1], sizeof(PendingProgram) * (array_length(g_pending) - 1));
+        array_length(g_pending)--;
+
+        shader_apply_pending(&pending);
+    }
+}
+
+void shader_reload_all() {
+    for (isize i = 0; i < g_sources.capacity; i++) {
+        if (g_sources.entries[i].path != NULL) {
+            shader_invalidate_expansion(&g_sources.entries[i]);
+        }
+    }
+
+    for (isize id = 0; id < shader_count(); id++) {
+        shader_recompile((ShaderId)id);
+    }
+}
+
+bool shader_recompile_dirty() {
+    bool started = false;
+
+    for (isize id = 0; id < shader_count(); id++) {
+        if (g_shaders[id].dirty) {
+            started |= shader_recompile((ShaderId)id);
+        }
+    }
+    return started;
+}
+
+// Loads the manifest and submits every shader, without waiting for them. Returns
+// false if the manifest could not be read.
+bool shader_load_registry() {
+    source_table_init(&g_sources, 64);
+    array_init(g_shaders);
+    array_init(g_pending);
+    array_init(g_stage_objects);
+    array_init(g_stage_programs);
+    array_init(g_variants);
+    array_init(g_manifest_variants);
+
+    // Let the driver use as many compiler threads as it wants.
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+
+    if (!shader_load_manifest()) {
+        return false;
+    }
+
+    // Every program is submitted before waiting for any of them, so they are
+    // compiled in parallel where the driver can.
+    for (isize id = 0; id < shader_count(); id++) {
+        shader_recompile((ShaderId)id);
+    }
+    return true;
+}
+
+void shader_initialize() {
+    shader_load_registry();
+    shader_finish();
+}
+
+bool shader_start_compile_thread(GLFWwindow *context) {
+    LT_ASSERT(g_compile_context == NULL);
+
+    if (g_separable) {
+        printf("Program pipelines are not shared between contexts, separable programs are built on the render thread\n");
+        return false;
+    }
+
+    array_init(g_compile_jobs);
+    array_init(g_compile_results);
+    g_compile_quit = false;
+    g_compile_context = context;
+
+    if (pthread_create(&g_compile_thread, NULL, shader_compile_thread, NULL) != 0) {
+        fprintf(stderr, "Could not start the shader compile thread\n");
+        g_compile_context = NULL;
+        array_free(g_compile_jobs);
+        array_free(g_compile_results);
+        return false;
+    }
+    return true;
+}
+
+void shader_stop_compile_thread() {
+    if (g_compile_context == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_compile_mutex);
+    g_compile_quit = true;
+    pthread_cond_signal(&g_compile_cond);
+    pthread_mutex_unlock(&g_compile_mutex);
+    pthread_join(g_compile_thread, NULL);
+
+    for (isize i = 0; i < array_length(g_compile_jobs); i++) {
+        string_free(g_compile_jobs[i].source);
+        if (g_compile_jobs[i].defines != NULL) {
+            string_free(g_compile_jobs[i].defines);
+        }
+    }
+    for (isize i = 0; i < array_length(g_compile_results); i++) {
+        if (g_compile_results[i].fence != NULL) {
+            glDeleteSync(g_compile_results[i].fence);
+        }
+        glDeleteProgram(g_compile_results[i].program);
+    }
+    array_free(g_compile_jobs);
+    array_free(g_compile_results);
+    g_compile_jobs = NULL;
+    g_compile_results = NULL;
+
+    for (isize id = 0; id < shader_count(); id++) {
+        g_shaders[id].building_hash = 0;
+    }
+    for (isize i = 0; i < array_length(g_variants); i++) {
+        g_variants[i].building_hash = 0;
+    }
+    g_compile_context = NULL;
+}
+
+bool shader_use_separable_programs(bool enable) {
+    LT_ASSERT(g_shaders == NULL);
+
+    if (enable && !GLAD_GL_ARB_separate_shader_objects) {
+        printf("The driver has no separable programs, linking whole programs\n");
+        enable = false;
+    }
+    g_separable = enable;
+    return enable;
+}
+
+// Key of the variant of the shader with the defines. The hashes of the defines are
+// added up, so their order does not matter.
+u64 shader_variant_key(ShaderId id, const ShaderDefine *defines, isize num_defines) {
+    u64 sum = 0;
+
+    for (isize i = 0; i < num_defines; i++) {
+        const char *value = defines[i].value ? defines[i].value : "";
+        u64 hash = lt_hash64(defines[i].name, (isize)strlen(defines[i].name), 0);
+        sum += lt_hash64(value, (isize)strlen(value), hash);
+    }
+
+    u64 key = lt_hash64(&id, sizeof(id), sum);
+    // 0 stands for the program of the shader itself.
+    return key != 0 ? key : 1;
+}
+
+// Builds the variant out of the current source of its shader.
+void shader_build_variant(ShaderVariant *variant) {
+    Shader *shader = &g_shaders[variant->id];
+    const String *shader_string = shader_expand(shader->file->data, 0);
+    BuildTimes times = {0};
+
+    if (shader_string == NULL) {
+        variant->source_hash = shader->expanded_hash;
+        shader_build_done(variant->id, variant->key, &times, false);
+        return;
+    }
+
+    u64 source_hash = shader_hash_source(shader_string);
+    variant->building_hash = source_hash;
+
+    if (g_compile_context != NULL) {
+        shader_queue_compile(variant->id, variant->key, variant->defines, shader_string, source_hash);
+        return;
+    }
+
+    StageSources sources;
+    shader_stage_sources(shader_string, variant->defines->data, &sources);
+
+    PendingProgram pending = {0};
+    pending.id = variant->id;
+    pending.variant_key = variant->key;
+    pending.source_hash = source_hash;
+    pending.cache_key = shader_program_cache_key(&sources);
+
+    u64 load_start_ns = metrics_now_ns();
+    GLuint cached_program = shader_cache_load(pending.cache_key);
+    if (cached_program != 0) {
+        times.cache_load_ns = metrics_now_ns() - load_start_ns;
+        variant->building_hash = 0;
+        shader_build_done(variant->id, variant->key, &times, true);
+        shader_swap_variant(variant, cached_program, source_hash);
+    } else if (shader_submit_program(&sources, &pending)) {
+        array_append(g_pending, pending);
+    } else {
+        variant->building_hash = 0;
+        variant->source_hash = source_hash;
+        shader_build_done(variant->id, variant->key, &times, false);
+    }
+    shader_free_stage_sources(&sources);
+}
+
+GLuint shader_get_variant(ShaderId id, const ShaderDefine *defines, isize num_defines, bool wait) {
+    LT_ASSERT(id >= 0 && id < shader_count());
+    Shader *shader = &g_shaders[id];
+    u64 key = shader_variant_key(id, defines, num_defines);
+    ShaderVariant *variant = variant_find(key);
+
+    if (variant == NULL) {
+        ShaderVariant new_variant = {0};
+        new_variant.key = key;
+        new_variant.id = id;
+        new_variant.defines = string_make("");
+        new_variant.label = string_make("");
+
+        for (isize i = 0; i < num_defines; i++) {
+            const char *value = defines[i].value ? defines[i].value : "";
+            string_append_length(new_variant.defines, "#define ", 8);
+            string_append_length(new_variant.defines, defines[i].name, strlen(defines[i].name));
+            string_append_length(new_variant.defines, " ", 1);
+            string_append_length(new_variant.defines, value, strlen(value));
+            string_append_length(new_variant.defines, "\n", 1);
+
+            if (i > 0) {
+                string_append_length(new_variant.label, " ", 1);
+            }
+            string_append_length(new_variant.label, defines[i].name, strlen(defines[i].name));
+            if (defines[i].value != NULL) {
+                string_append_length(new_variant.label, "=", 1);
+                string_append_length(new_variant.label, value, strlen(value));
+            }
+        }
+
+        array_append(g_variants, new_variant);
+        variant = &g_variants[array_length(g_variants) - 1];
+    }
+    variant->last_used = g_frame;
+
+    // Built on the first request, and again once the source of the shader changed.
+    // The old program is used until then.
+    bool stale = variant->source_hash != shader->expanded_hash &&
+                 variant->building_hash != shader->expanded_hash;
+    if (stale && shader->expanded_hash != 0) {
+        shader_build_variant(variant);
+        if (wait) {
+            shader_finish();
+            variant = variant_find(key);
+        }
+    }
+    return variant->program;
+}
+
+void shader_set_variant_budget(u64 bytes) {
+    g_variant_budget = bytes;
+}
+
+void shader_set_resources_path(const char *dir) {
+    isize len = (isize)strlen(dir);
+    const char *separator = len > 0 && dir[len - 1] == '/' ? "" : "/";
+
+    snprintf(g_resources_dir, sizeof(g_resources_dir), "%s%s", dir, separator);
+    resources_path = g_resources_dir;
+}
+
+// Splits the `NAME` and `NAME=VALUE` words of a manifest variant in place. Returns
+// the number of defines.
+isize shader_parse_defines(char *text, ShaderDefine *defines, isize max_defines) {
+    isize num_defines = 0;
+    char *c = text;
+
+    while (*c != '\0' && num_defines < max_defines) {
+        while (*c == ' ' || *c == '\t') { *c++ = '\0'; }
+        if (*c == '\0') {
+            break;
+        }
+
+        ShaderDefine *define = &defines[num_defines++];
+        define->name = c;
+        define->value = NULL;
+
+        while (*c != '\0' && *c != ' ' && *c != '\t') {
+            if (*c == '=' && define->value == NULL) {
+                *c = '\0';
+                define->value = c + 1;
+            }
+            c++;
+        }
+    }
+    return num_defines;
+}
+
+bool shader_precompile() {
+    g_precompiling = true;
+    g_num_builds = 0;
+    g_failed_builds = 0;
+    u64 start_ns = metrics_now_ns();
+
+    printf("Precompiling the shaders of %s\n", resources_path);
+    bool loaded = shader_load_registry();
+
+    // The variants go along with the shaders, so the driver compiles all of them at once.
+    for (isize i = 0; i < array_length(g_manifest_variants) && loaded; i++) {
+        String *text = string_make(g_manifest_variants[i].defines->data);
+        ShaderDefine defines[MAX_VARIANT_DEFINES];
+        isize num_defines = shader_parse_defines(text->data, defines, MAX_VARIANT_DEFINES);
+
+        shader_get_variant(g_manifest_variants[i].id, defines, num_defines, false);
+        string_free(text);
+    }
+    shader_finish();
+
+    printf("Built %d programs in %.2f ms, %d failed\n", g_num_builds,
+           (metrics_now_ns() - start_ns) / 1e6, g_failed_builds);
 
-    g_shaders[ShaderKind_Basic] = basic_shader;
+    g_precompiling = false;
+    return loaded && g_failed_builds == 0;
 }
@@ -2,14 +2,95 @@
 #define SHADER_H
 
 #include "glad/glad.h"
+#include <GLFW/glfw3.h>
+#include "lt.h"
 
-typedef enum ShaderKind {
-    ShaderKind_Basic,
-    ShaderKind_Count
-} ShaderKind;
+// Dense index of a shader in the registry, which is loaded from the shader manifest
+// of the resources folder. Ids never change while the program runs, so they should be
+// resolved once with shader_find and kept.
+typedef i32 ShaderId;
 
-void   shader_initialize();
-GLuint shader_get_program(ShaderKind kind);
-void   shader_recompile(ShaderKind kind);
+#define SHADER_INVALID_ID -1
+
+// Programs of the variants of every shader are deleted, least recently requested
+// first, when they take more than this.
+#define SHADER_VARIANT_DEFAULT_BUDGET (32ull * 1024 * 1024)
+
+// Define of a variant, the value can be NULL.
+typedef struct ShaderDefine {
+    const char *name;
+    const char *value;
+} ShaderDefine;
+
+// Builds every stage as a separable program (ARB_separate_shader_objects), bound
+// through a program pipeline per shader. Stage programs are shared by every pipeline
+// using the same stage text, and a reload that changes a single stage only points
+// the pipeline at the new stage, without linking the others again. Has to be called
+// before shader_initialize. Returns false if the driver has no separable programs.
+bool        shader_use_separable_programs(bool enable);
+// Folder the manifest and every source are read from. Has to be called before
+// shader_initialize.
+void        shader_set_resources_path(const char *dir);
+void        shader_initialize();
+// Loads the registry like shader_initialize and builds every shader, and every
+// variant listed in the manifest, waiting for all of them. The time or the errors of
+// each build are printed, and successful builds are saved in the shader cache when
+// it is enabled. Returns false if the manifest could not be read or a build failed.
+bool        shader_precompile();
+isize       shader_count();
+// Returns SHADER_INVALID_ID if no shader has the name. Meant to be called once per
+// shader, not every frame.
+ShaderId    shader_find(const char *name);
+const char *shader_get_name(ShaderId id);
+// Always 0 in separable mode, where shader_bind has to be used instead.
+GLuint      shader_get_program(ShaderId id);
+// Makes the program, or the pipeline in separable mode, the one used for drawing.
+void        shader_bind(ShaderId id);
+void        shader_unbind();
+// Submits the program to the driver, or to the compile thread when it runs. The old
+// program stays in use until the new one is swapped in by shader_update or
+// shader_finish. Returns true if a build was started, false if the source failed to
+// load, is unchanged or is already being built.
+bool        shader_recompile(ShaderId id);
+// Swaps in the programs the driver finished building. Called once per frame, it never
+// waits for the driver when KHR_parallel_shader_compile is available, or when the
+// programs are built on the compile thread.
+void        shader_update();
+// Waits for every submitted program and swaps them in.
+void        shader_finish();
+
+// Builds the programs on a thread of their own, with the context of a hidden window
+// sharing its objects with the render context. It is made current on that thread,
+// so it must not be current anywhere else. Finished programs are guarded by a fence
+// and swapped in by shader_update once the GPU executed their build. Returns false
+// if the thread could not be started, the programs are then built on the render
+// thread.
+bool        shader_start_compile_thread(GLFWwindow *context);
+// Waits for the build in progress and drops the ones not swapped in yet. The
+// context can be destroyed afterwards.
+void        shader_stop_compile_thread();
+
+// Returns the program of the shader built with the extra defines, whose order does
+// not matter. It is built on the first request, in the background unless wait is
+// set, and 0 is returned until it is ready. After the source of the shader changes
+// the old program is returned until the new one is ready. Variants are whole
+// programs, also in separable mode, and are evicted at frame boundaries once their
+// programs go over the budget.
+GLuint      shader_get_variant(ShaderId id, const ShaderDefine *defines, isize num_defines, bool wait);
+void        shader_set_variant_budget(u64 bytes);
+
+// Sources can include other files with `#include "file"`, relative to the including
+// file. Expanded files are cached until they, or a file they include, change.
+//
+// Marks every program built from the file, or from a file including it, as needing a
+// recompile. The path is either inside the resources folder or relative to it.
+// Returns false if no program uses it. Saving the manifest registers the shaders
+// added to it.
+bool        shader_file_changed(const char *path);
+// Recompiles the programs marked by shader_file_changed, each one only once. Returns
+// true if any build was started.
+bool        shader_recompile_dirty();
+// Drops every cached expansion and recompiles every program.
+void        shader_reload_all();
 
 #endif // SHADER_H
@@ -0,0 +1,345 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "glad/glad.h"
+
+#include "shader_cache.h"
+#include "lt.h"
+
+#define CACHE_MAGIC   0x48434853u // "SHCH"
+#define CACHE_VERSION 1
+#define CACHE_SUFFIX  ".bin"
+// Eviction goes down to this percentage of the size limit, so a full cache is not
+// scanned again on the very next store.
+#define CACHE_EVICT_TARGET_PERCENT 75
+
+// Header of a cache file, followed by the binary.
+typedef struct CacheHeader {
+    u32 magic;
+    u32 version;
+    u64 key;
+    // Hash of the binary, so truncated or corrupted files are never given to the driver.
+    u64 checksum;
+    u32 format;
+    u32 length;
+} CacheHeader;
+
+_Static_assert(sizeof(CacheHeader) == 32, "CacheHeader should not have padding");
+
+// Cache file found while looking for entries to evict.
+typedef struct CacheFile {
+    u64  mtime_ns;
+    u64  size;
+    char name[32];
+} CacheFile;
+
+static bool g_enabled     = false;
+static char g_dir[PATH_MAX];
+static u64  g_max_bytes   = 0;
+// Size of the entries, counted by a scan of the folder and kept up to date by the
+// stores, so the folder is only scanned again once it grows past g_max_bytes.
+// Entries written by other processes only show up on the next scan.
+static u64  g_total_bytes = 0;
+// Hash of the vendor, renderer and version strings. Binaries are only valid for the
+// driver that created them.
+static u64  g_driver_hash = 0;
+
+u64 cache_file_mtime_ns(const struct stat *st) {
+#if defined(__APPLE__)
+    return (u64)st->st_mtimespec.tv_sec * 1000000000ull + (u64)st->st_mtimespec.tv_nsec;
+#else
+    return (u64)st->st_mtim.tv_sec * 1000000000ull + (u64)st->st_mtim.tv_nsec;
+#endif
+}
+
+// Creates dir and every missing parent. Returns false if it could not be created.
+bool cache_make_dir(const char *dir) {
+    char path[PATH_MAX];
+    isize len = (isize)strlen(dir);
+
+    if (len == 0 || len >= (isize)sizeof(path)) {
+        return false;
+    }
+    memcpy(path, dir, len + 1);
+
+    for (isize i = 1; i <= len; i++) {
+        if (path[i] == '/' || path[i] == '\0') {
+            char c = path[i];
+            path[i] = '\0';
+            if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+                return false;
+            }
+            path[i] = c;
+        }
+    }
+    return true;
+}
+
+// Returns false if the path does not fit.
+bool cache_file_path(char *out, isize size, u64 key, const char *suffix) {
+    i32 n = snprintf(out, size, "%s/%016llx%s", g_dir, (unsigned long long)key, suffix);
+    return n >= 0 && n < size;
+}
+
+i32 compare_cache_files(const void *a, const void *b) {
+    u64 x = ((const CacheFile *)a)->mtime_ns;
+    u64 y = ((const CacheFile *)b)->mtime_ns;
+    return (x > y) - (x < y);
+}
+
+// Removes the least recently used entries once the cache is over its size limit,
+// until it is back under the eviction target. Sets g_total_bytes to the size of
+// what is left.
+void cache_evict() {
+    DIR *dir = opendir(g_dir);
+    if (dir == NULL) {
+        return;
+    }
+
+    Array(CacheFile) files;
+    array_init(files);
+    u64 total = 0;
+
+    char path[PATH_MAX];
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        isize len = (isize)strlen(de->d_name);
+        isize suffix_len = (isize)strlen(CACHE_SUFFIX);
+
+        if (len <= suffix_len || len >= (isize)sizeof(((CacheFile *)0)->name) ||
+            strcmp(de->d_name + len - suffix_len, CACHE_SUFFIX) != 0) {
+            continue;
+        }
+
+        struct stat st;
+        i32 n = snprintf(path, sizeof(path), "%s/%s", g_dir, de->d_name);
+        if (n < 0 || n >= (i32)sizeof(path) || stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        CacheFile file = {0};
+        file.mtime_ns = cache_file_mtime_ns(&st);
+        file.size = (u64)st.st_size;
+        memcpy(file.name, de->d_name, len + 1);
+        array_append(files, file);
+        total += file.size;
+    }
+    closedir(dir);
+
+    if (total > g_max_bytes) {
+        u64 target = g_max_bytes / 100 * CACHE_EVICT_TARGET_PERCENT;
+        qsort(files, array_length(files), sizeof(CacheFile), compare_cache_files);
+
+        for (isize i = 0; i < array_length(files) && total > target; i++) {
+            i32 n = snprintf(path, sizeof(path), "%s/%s", g_dir, files[i].name);
+            if (n < 0 || n >= (i32)sizeof(path)) {
+                continue;
+            }
+            if (unlink(path) == 0) {
+                total -= files[i].size;
+            }
+        }
+    }
+
+    array_free(files);
+    g_total_bytes = total;
+}
+
+// Size of the file at path, or 0 if there is none.
+u64 cache_file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (u64)st.st_size : 0;
+}
+
+bool shader_cache_initialize(const char *dir, u64 max_bytes) {
+    g_enabled = false;
+
+    GLint num_formats = 0;
+    if (GLAD_GL_ARB_get_program_binary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    }
+    if (num_formats <= 0) {
+        printf("The driver can not save program binaries, the shader cache is disabled\n");
+        return false;
+    }
+
+    if (dir != NULL) {
+        snprintf(g_dir, sizeof(g_dir), "%s", dir);
+    } else if (getenv("XDG_CACHE_HOME") != NULL) {
+        snprintf(g_dir, sizeof(g_dir), "%s/shloader", getenv("XDG_CACHE_HOME"));
+    } else if (getenv("HOME") != NULL) {
+        snprintf(g_dir, sizeof(g_dir), "%s/.cache/shloader", getenv("HOME"));
+    } else {
+        printf("No folder for the shader cache, it is disabled\n");
+        return false;
+    }
+
+    if (!cache_make_dir(g_dir)) {
+        fprintf(stderr, "Could not create the shader cache in %s, it is disabled\n", g_dir);
+        return false;
+    }
+
+    const GLenum identity[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    g_driver_hash = 0;
+    for (isize i = 0; i < (isize)(sizeof(identity) / sizeof(identity[0])); i++) {
+        const char *str = (const char *)glGetString(identity[i]);
+        str = str ? str : "";
+        g_driver_hash = lt_hash64(str, (isize)strlen(str), g_driver_hash);
+    }
+
+    g_max_bytes = max_bytes;
+    g_enabled = true;
+    cache_evict();
+    printf("Shader cache in %s\n", g_dir);
+    return true;
+}
+
+bool shader_cache_enabled() {
+    return g_enabled;
+}
+
+u64 shader_cache_key(const char *const *const *stage_sources, const isize *num_sources,
+                     isize num_stages) {
+    u64 key = g_driver_hash;
+
+    // The counts are hashed too, so moving text between strings or stages changes the key.
+    for (isize stage = 0; stage < num_stages; stage++) {
+        key = lt_hash64(&num_sources[stage], sizeof(num_sources[stage]), key);
+        for (isize i = 0; i < num_sources[stage]; i++) {
+            const char *str = stage_sources[stage][i];
+            isize len = (isize)strlen(str);
+            key = lt_hash64(&len, sizeof(len), key);
+            key = lt_hash64(str, len, key);
+        }
+    }
+    return key;
+}
+
+GLuint shader_cache_load(u64 key) {
+    if (!g_enabled) {
+        return 0;
+    }
+
+    char path[PATH_MAX];
+    if (!cache_file_path(path, sizeof(path), key, CACHE_SUFFIX)) {
+        return 0;
+    }
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return 0;
+    }
+
+    CacheHeader header;
+    void *binary = NULL;
+    bool valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+                 header.magic == CACHE_MAGIC && header.version == CACHE_VERSION &&
+                 header.key == key && header.length > 0;
+
+    if (valid) {
+        binary = malloc(header.length);
+        valid = fread(binary, 1, header.length, fp) == header.length &&
+                lt_hash64(binary, header.length, 0) == header.checksum;
+    }
+    fclose(fp);
+
+    GLuint program = 0;
+    if (valid) {
+        program = glCreateProgram();
+        glProgramBinary(program, header.format, binary, (GLsizei)header.length);
+
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    lt_free(binary);
+
+    if (program == 0) {
+        // Corrupted, or the driver does not take it anymore. It is rebuilt and stored again.
+        printf("Removing stale shader cache entry %s\n", path);
+        u64 size = cache_file_size(path);
+        if (unlink(path) == 0) {
+            g_total_bytes -= lt_min(size, g_total_bytes);
+        }
+        return 0;
+    }
+
+    // The mtime is the last use, for the eviction.
+    utimensat(AT_FDCWD, path, NULL, 0);
+    return program;
+}
+
+void shader_cache_prepare(GLuint program) {
+    if (g_enabled) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+void shader_cache_store(u64 key, GLuint program) {
+    if (!g_enabled) {
+        return;
+    }
+
+    // Written next to the entry and renamed over it, so a reader never sees half a file.
+    char tmp_path[PATH_MAX];
+    char path[PATH_MAX];
+    if (!cache_file_path(tmp_path, sizeof(tmp_path), key, ".tmp") ||
+        !cache_file_path(path, sizeof(path), key, CACHE_SUFFIX)) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    void *binary = malloc(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &written, &format, binary);
+
+    CacheHeader header = {0};
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.key = key;
+    header.checksum = lt_hash64(binary, written, 0);
+    header.format = format;
+    header.length = (u32)written;
+
+    FILE *fp = fopen(tmp_path, "wb");
+    bool written_ok = fp != NULL && written > 0 &&
+                      fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                      fwrite(binary, 1, written, fp) == (usize)written;
+    if (fp != NULL && fclose(fp) != 0) {
+        written_ok = false;
+    }
+    lt_free(binary);
+
+    // An entry written over is not counted twice.
+    u64 replaced_size = cache_file_size(path);
+
+    if (!written_ok || rename(tmp_path, path) < 0) {
+        fprintf(stderr, "Could not write shader cache entry %s\n", path);
+        unlink(tmp_path);
+        return;
+    }
+
+    g_total_bytes += sizeof(header) + (u64)written;
+    g_total_bytes -= lt_min(replaced_size, g_total_bytes);
+    if (g_total_bytes > g_max_bytes) {
+        cache_evict();
+    }
+}
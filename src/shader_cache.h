@@ -0,0 +1,35 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "glad/glad.h"
+#include "lt.h"
+
+// Persistent cache of linked program binaries (ARB_get_program_binary). Entries are
+// keyed by a hash of every source string of every stage and of the driver identity,
+// so editing a shader, changing its defines or updating the driver all miss. The
+// cache is a folder with one file per program. Using an entry touches its mtime,
+// and the least recently used entries are removed when the folder grows past its
+// size limit.
+//
+// Not thread safe, it is only ever used by one thread at a time.
+
+#define SHADER_CACHE_DEFAULT_MAX_BYTES (64ull * 1024 * 1024)
+
+// Has to be called with a GL context current. When dir is NULL the cache goes in
+// $XDG_CACHE_HOME/shloader, or ~/.cache/shloader. Returns false, and leaves the
+// cache disabled, if the driver can not save binaries or the folder is not usable.
+bool   shader_cache_initialize(const char *dir, u64 max_bytes);
+bool   shader_cache_enabled();
+
+// Key of the program built from the given source strings of every stage.
+u64    shader_cache_key(const char *const *const *stage_sources, const isize *num_sources,
+                        isize num_stages);
+// Returns a new linked program created from the cached binary, or 0 on a miss. Stale
+// entries the driver rejects are removed.
+GLuint shader_cache_load(u64 key);
+// Has to be called before linking a program that is going to be stored.
+void   shader_cache_prepare(GLuint program);
+// Saves the binary of a linked program.
+void   shader_cache_store(u64 key, GLuint program);
+
+#endif // SHADER_CACHE_H
@@ -1,189 +1,1754 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 #include <stdio.h>
-#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <poll.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <memory.h>
-#include <linux/limits.h>
+#include <limits.h>
 #include <errno.h>
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 #include "lt.h"
 #include "watcher.h"
 
 #ifdef __linux__
-#define LEN_NAME PATH_MAX
-#else
-// @FIXME(leo): This should not be harcoded for other operating systems.
-#define LEN_NAME         16
-#endif
 #define EVENT_SIZE       (sizeof(struct inotify_event))
-#define MAX_EVENTS       1024
-#define BUF_LEN          (MAX_EVENTS * (EVENT_SIZE + LEN_NAME))
+// Reads return as many whole events as fit, so the buffer only has to hold one
+// event with the longest possible name. Bursts are drained with several reads.
+#define BUF_LEN          4096
+// IN_MODIFY is not watched on purpose: it fires for every write of a save, and
+// would make the consumer compile a half-written file. See WATCHER_FILE_CHANGED.
+#define WATCH_MASK       (IN_CLOSE_WRITE|IN_MOVED_TO|IN_MOVED_FROM|IN_CREATE|IN_DELETE)
+#endif
 #define PATH             "/home/lhahn/dev/c/shader-loader/resources"
-#define EVENT_BUFFER_LEN 50
+// Must be a power of two, so indices can be masked instead of wrapped.
+#define EVENT_BUFFER_LEN WATCHER_MAX_EVENTS
+#define MAX_GLOBS        16
+#define MAX_IGNORES      32
+#define CACHE_LINE_SIZE  64
+// Maximum number of distinct paths that can be waiting for their debounce window,
+// or for room in the event buffer. Past that the watcher raises the overflow flag.
+#define MAX_PENDING      256
+// A path that keeps changing is flushed anyway after this many debounce windows.
+#define MAX_DEBOUNCE_WINDOWS 8
+#define TRACE_MAGIC      "SHLTRACE"
+#define TRACE_VERSION    1
+// The trace has content snapshots.
+#define TRACE_FLAG_CONTENTS 0x1
+// Contents length of records without a snapshot.
+#define TRACE_NO_CONTENTS   0xffffffffu
+
+_Static_assert((EVENT_BUFFER_LEN & (EVENT_BUFFER_LEN - 1)) == 0,
+               "EVENT_BUFFER_LEN should be a power of two");
+#ifdef __linux__
+_Static_assert(BUF_LEN >= EVENT_SIZE + NAME_MAX + 1,
+               "BUF_LEN should fit at least one event");
+#endif
+_Static_assert(WATCHER_MAX_SUBSCRIPTIONS <= 32,
+               "Subscriptions should fit in a u32 mask");
 
+// Single-producer/single-consumer ring. Only the watcher thread writes `head` and
+// only the consumer writes `tail`. Both are free running counters that get masked
+// into `events`, and each one sits on its own cache line so the two threads never
+// write to the same line.
 typedef struct EventBuffer {
-    isize                head;
-    isize                tail;
-    isize                maxlen;
-    WatcherEvent        *events;
+    _Alignas(CACHE_LINE_SIZE) _Atomic usize head;
+    // Written by the watcher thread only, next to head. Read by watcher_get_stats.
+    _Atomic isize high_water;
+    _Atomic u64   delivered;
+    _Alignas(CACHE_LINE_SIZE) _Atomic usize tail;
+    // Raised by the watcher thread when it found the buffer full. The consumer
+    // clears it and signals the room descriptor once it freed a slot.
+    atomic_bool   wants_room;
+    // Tail at the start of the last drain or peek, empty ones included. The consumer
+    // came back for more, so it is done with every event before it.
+    _Atomic usize processed;
+    _Alignas(CACHE_LINE_SIZE) WatcherEvent  events[EVENT_BUFFER_LEN];
 } EventBuffer;
 
-// Event buffer
-static EventBuffer     g_event_buffer = {0, 0, 0, 0};
-static pthread_mutex_t g_mutex_event_buffer;
-// Running state
-static bool            g_running      = false;
-static pthread_mutex_t g_mutex_running;
+// Event waiting for its debounce window to elapse. Events on the same path are
+// merged into it until no new event arrives for the whole window. When the event
+// buffer is full, flushed entries stay here, so the table doubles as a bounded
+// per-path dirty set.
+typedef struct PendingEvent {
+    const String *name;
+    u32     mask;
+    // Subscriptions the event still has to be delivered to.
+    u32     subscribers;
+    u64     first_ns;
+    u64     deadline_ns;
+    // The last event removed the path, which is reclaimed once the event is delivered.
+    bool    removed;
+} PendingEvent;
+
+#ifdef __linux__
+// Watched directory. The path is the root as given in the config joined with the
+// relative path of the directory, so event paths can be opened directly.
+typedef struct WatchEntry {
+    i32     wd;
+    String *path;
+    // Length of the root at the start of path, the rest is relative to it.
+    isize   root_len;
+} WatchEntry;
+
+// Hash map from watch descriptor to directory, using open addressing with linear
+// probing. Empty slots have a wd of -1.
+typedef struct WatchTable {
+    WatchEntry *entries;
+    isize       capacity; // Always a power of two.
+    isize       count;
+} WatchTable;
+#endif
+
+// Interned path. Every path is allocated once, the first time it is seen, and
+// events only carry pointers to it, so steady state delivery does not allocate.
+// Paths nobody is interested in are not interned at all, and removed paths are
+// reclaimed, so the table follows the files that exist instead of every name seen.
+typedef struct PathEntry {
+    u64     hash;
+    String *path;
+    // Subscriptions interested in the path. Globs are only matched once per path and
+    // watcher run, the first time it is seen. Zero when the path is ignored.
+    u32     subscribers;
+    // Value of g_mask_generation when subscribers was matched.
+    u32     mask_generation;
+
+    // Metadata recorded by the polling backend on its last scan.
+    u64     ino;
+    u64     size;
+    u64     mtime_ns;
+    u32     scan_generation;
+    // Events seen on the last scan, only reported once the metadata stopped changing.
+    u32     settling_mask;
+    bool    present;
+    bool    is_dir;
+    // Slot of a reclaimed path. Lookups probe past it and inserts reuse it, so
+    // removing a path never moves the other entries.
+    bool    tombstone;
+} PathEntry;
+
+// Hash set of interned paths, using open addressing with linear probing. Empty
+// slots have a NULL path.
+typedef struct PathTable {
+    PathEntry *entries;
+    isize      capacity; // Always a power of two.
+    isize      count;
+    isize      used;     // Entries and tombstones.
+} PathTable;
 
+// Name of a reclaimed path. Events carrying it can still be in the event buffers, or
+// in a batch the consumer is processing, so it is only freed once every consumer
+// came back for more events.
+typedef struct RetiredPath {
+    String *path;
+    // Head of every event buffer when the path was reclaimed.
+    usize   heads[WATCHER_MAX_SUBSCRIPTIONS];
+} RetiredPath;
 
-void initialize_event_buffer(EventBuffer *eb, isize maxlen) {
-    eb->head = 0;
-    eb->tail = 0;
-    eb->maxlen = maxlen;
-    eb->events = malloc(sizeof(WatcherEvent) * maxlen);
+// Header of an event trace, followed by one TraceRecord per event. Everything is
+// written in host byte order, traces are meant to be replayed where they were recorded.
+typedef struct TraceHeader {
+    char magic[8];
+    u32  version;
+    u32  flags;
+    u32  num_roots;
+    u32  reserved;
+} TraceHeader;
 
-    for (isize i = 0; i < maxlen; i++) {
-        eb->events[i].inotify_mask = -1;
-        eb->events[i].name = NULL;
+// The relative path follows the record, without a terminator, and then the contents
+// snapshot if there is one.
+typedef struct TraceRecord {
+    u64 time_ns;      // Since the recording started.
+    u32 mask;
+    u32 contents_len; // TRACE_NO_CONTENTS when there is no snapshot.
+    u16 root;         // Index in the roots of the config.
+    u16 path_len;
+    u32 reserved;
+} TraceRecord;
+
+_Static_assert(sizeof(TraceHeader) == 24 && sizeof(TraceRecord) == 24,
+               "Trace structs should not have padding");
+
+// Subscriber of the watcher, with its own event buffer and overflow flag.
+typedef struct Subscription {
+    EventBuffer buffer;
+    // Raised when events had to be dropped. The consumer should rescan everything.
+    atomic_bool overflowed;
+    String     *globs[MAX_GLOBS];
+    isize       num_globs;
+} Subscription;
+
+// Subscriptions and ignore rules. They are registered before the watcher thread is
+// started and never change while it runs. The event buffers have static storage,
+// so consumers can poll them safely before the thread is started.
+static Subscription    g_subscriptions[WATCHER_MAX_SUBSCRIPTIONS];
+static isize           g_num_subscriptions = 0;
+static String         *g_ignores[MAX_IGNORES];
+static isize           g_num_ignores  = 0;
+static atomic_bool     g_started      = false;
+// Wakeup state. The descriptor is created once and shared by watcher_start and
+// watcher_stop, so a stop issued before the thread starts waiting is not lost. On
+// Linux both ends are the same eventfd, elsewhere they are the ends of a pipe.
+static i32             g_wakeup_fd    = -1;
+static i32             g_wakeup_write_fd = -1;
+// Signaled by a consumer when it made room in a full event buffer, so the watcher
+// thread can sleep until then instead of retrying. Same layout as the wakeup one.
+static i32             g_room_fd      = -1;
+static i32             g_room_write_fd = -1;
+static pthread_once_t  g_wakeup_once  = PTHREAD_ONCE_INIT;
+// Pending events, only touched by the watcher thread.
+static PendingEvent    g_pending[MAX_PENDING];
+static isize           g_num_pending  = 0;
+static u64             g_debounce_ns  = 0;
+static bool            g_buffer_full  = false;
+// When flush_pending last ran. Events due by then and still pending are waiting
+// for room in an event buffer.
+static u64             g_flushed_ns   = 0;
+// Counters, only written by the watcher thread.
+static _Atomic u64     g_coalesced    = 0;
+static _Atomic u64     g_dropped      = 0;
+static _Atomic u64     g_overflows    = 0;
+// Interned event names, only written by the watcher thread. The strings are never
+// modified once published, and only freed through g_retired, so the consumer can
+// read the names of the events it got until it asks for the next ones.
+static PathTable       g_paths        = {0};
+// Bumped by every watcher_start. Subscriptions, ignore rules and roots may have
+// changed since the previous run, so masks matched before are matched again.
+static u32             g_mask_generation = 0;
+static Array(RetiredPath) g_retired   = NULL;
+#ifdef __linux__
+// Watched directories, only touched by the watcher thread.
+static WatchTable      g_watches      = {0};
+#endif
+// Roots of the running watcher and the trace being recorded, only touched by the
+// watcher thread.
+static String        **g_roots        = NULL;
+static isize           g_num_roots    = 0;
+static FILE           *g_trace        = NULL;
+static bool            g_trace_contents = false;
+static u64             g_trace_start_ns = 0;
+
+
+void initialize_wakeup_fd() {
+#ifdef __linux__
+    g_wakeup_fd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    g_wakeup_write_fd = g_wakeup_fd;
+    g_room_fd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    g_room_write_fd = g_room_fd;
+#else
+    i32 fds[2];
+    if (pipe(fds) == 0) {
+        g_wakeup_fd = fds[0];
+        g_wakeup_write_fd = fds[1];
+    }
+    if (pipe(fds) == 0) {
+        g_room_fd = fds[0];
+        g_room_write_fd = fds[1];
     }
+#endif
+
+    if (g_wakeup_fd < 0 || g_room_fd < 0) {
+        LT_FAIL("Failed creating the watcher wakeup descriptor.\n");
+    }
+}
+
+// Consumes the signals of the room descriptor, once it woke the watcher thread up.
+void clear_room_fd() {
+    u64 count[8];
+    isize unused = read(g_room_fd, count, sizeof(count));
+    LT_UNUSED(unused);
 }
 
-void free_event_buffer(EventBuffer *eb) {
-    lt_free(eb->events);
+u64 time_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
 }
 
-void set_running(bool r) {
-    pthread_mutex_lock(&g_mutex_running);
-    g_running = r;
-    pthread_mutex_unlock(&g_mutex_running);
+// CPU time used by the calling thread.
+u64 thread_cpu_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
 }
 
-void push_event(EventBuffer *buf, const struct inotify_event *ie) {
-    pthread_mutex_lock(&g_mutex_event_buffer);
+// Returns false when the buffer is full.
+bool push_event(EventBuffer *buf, const String *name, u32 mask, u64 read_ns) {
+    usize head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+    // Acquire pairs with the release in release_slots, so the slot is only reused
+    // after the consumer is done with it.
+    usize tail = atomic_load_explicit(&buf->tail, memory_order_acquire);
 
-    isize next_head = buf->head + 1;
-    if (next_head >= buf->maxlen) {
-        next_head = 0;
+    if (head - tail == EVENT_BUFFER_LEN) {
+        // Ask the consumer to signal when it makes room, and look again in case it
+        // just did. Both sides are sequentially consistent, so either the new tail
+        // is seen here or the consumer sees the request.
+        atomic_store_explicit(&buf->wants_room, true, memory_order_seq_cst);
+        tail = atomic_load_explicit(&buf->tail, memory_order_seq_cst);
+
+        if (head - tail == EVENT_BUFFER_LEN) {
+            return false;
+        }
+        atomic_store_explicit(&buf->wants_room, false, memory_order_relaxed);
     }
 
-    if (next_head == buf->tail) {
-        LT_FAIL("Circular buffer was overrun\n");
+    WatcherEvent *e = &buf->events[head & (EVENT_BUFFER_LEN - 1)];
+    e->inotify_mask = (i32)mask;
+    e->name = name;
+    e->read_ns = read_ns;
+    e->enqueue_ns = time_now_ns();
+
+    atomic_store_explicit(&buf->head, head + 1, memory_order_release);
+
+    isize depth = (isize)(head + 1 - tail);
+    if (depth > atomic_load_explicit(&buf->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&buf->high_water, depth, memory_order_relaxed);
     }
+    atomic_store_explicit(&buf->delivered,
+                          atomic_load_explicit(&buf->delivered, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    return true;
+}
 
-    buf->events[buf->head].inotify_mask = ie->mask;
-    buf->events[buf->head].name = string_make(ie->name);
-    buf->head = next_head;
+// Gives the slots before tail back to the watcher thread, and wakes it up if it is
+// waiting for room.
+void release_slots(EventBuffer *buf, usize tail) {
+    // Also a release, pairs with the acquire in push_event.
+    atomic_store_explicit(&buf->tail, tail, memory_order_seq_cst);
 
-    pthread_mutex_unlock(&g_mutex_event_buffer);
+    if (atomic_load_explicit(&buf->wants_room, memory_order_seq_cst) &&
+        atomic_exchange_explicit(&buf->wants_room, false, memory_order_relaxed)) {
+        u64 one = 1;
+        if (write(g_room_write_fd, &one, sizeof(one)) < 0) {
+            perror("Error signaling room to the watcher thread");
+        }
+    }
+}
+
+// The consumer is done with the events before tail. Release pairs with the acquire
+// in free_retired_paths, their names are not read anymore.
+void mark_processed(EventBuffer *buf, usize tail) {
+    // Only stored when it moved, so polling an empty buffer does not write to it.
+    if (atomic_load_explicit(&buf->processed, memory_order_relaxed) != tail) {
+        atomic_store_explicit(&buf->processed, tail, memory_order_release);
+    }
 }
 
 void consume_event(EventBuffer *buf) {
-    pthread_mutex_lock(&g_mutex_event_buffer);
+    usize tail = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+
+    LT_ASSERT(atomic_load_explicit(&buf->head, memory_order_relaxed) != tail);
 
-    LT_ASSERT(buf->head != buf->tail);
+    WatcherEvent *e = &buf->events[tail & (EVENT_BUFFER_LEN - 1)];
+    e->inotify_mask = -1;
+    e->name = NULL;
 
-    isize next_tail = buf->tail + 1;
-    if (next_tail >= buf->maxlen) {
-        next_tail = 0;
+    release_slots(buf, tail + 1);
+}
+
+WatcherSubscription watcher_subscribe(const char *const *globs, isize num_globs) {
+    LT_ASSERT(!atomic_load(&g_started));
+
+    if (g_num_subscriptions == WATCHER_MAX_SUBSCRIPTIONS || num_globs > MAX_GLOBS) {
+        fprintf(stderr, "Could not add watcher subscription\n");
+        return -1;
     }
 
-    buf->events[buf->tail].inotify_mask = -1;
-    string_free(buf->events[buf->tail].name);
-    buf->tail = next_tail;
+    Subscription *sub = &g_subscriptions[g_num_subscriptions];
+    for (isize i = 0; i < num_globs; i++) {
+        sub->globs[i] = string_make(globs[i]);
+    }
+    sub->num_globs = num_globs;
+
+    return (WatcherSubscription)g_num_subscriptions++;
+}
+
+void watcher_ignore(const char *glob) {
+    LT_ASSERT(!atomic_load(&g_started));
 
-    pthread_mutex_unlock(&g_mutex_event_buffer);
+    if (g_num_ignores == MAX_IGNORES) {
+        fprintf(stderr, "Could not add watcher ignore rule %s\n", glob);
+        return;
+    }
+    g_ignores[g_num_ignores++] = string_make(glob);
 }
 
-WatcherEvent *watcher_peek_event() {
-    pthread_mutex_lock(&g_mutex_event_buffer);
+// Matches str against a glob. `*` and `?` never match a `/`, while `**` matches
+// across directories.
+bool glob_match(const char *pattern, const char *str) {
+    const char *p = pattern;
+    const char *s = str;
+
+    for (; *p; p++) {
+        if (*p == '*') {
+            bool cross_dirs = p[1] == '*';
+            if (cross_dirs) {
+                p++;
+                // `**/` also matches no directory at all.
+                if (p[1] == '/' && glob_match(p + 2, s)) {
+                    return true;
+                }
+            }
 
-    if (g_event_buffer.head == g_event_buffer.tail) {
-        pthread_mutex_unlock(&g_mutex_event_buffer);
+            if (p[1] == '\0') {
+                return cross_dirs || strchr(s, '/') == NULL;
+            }
+
+            for (;; s++) {
+                if (glob_match(p + 1, s)) {
+                    return true;
+                }
+                if (*s == '\0' || (!cross_dirs && *s == '/')) {
+                    return false;
+                }
+            }
+        }
+
+        if (*s == '\0' || (*p == '?' ? *s == '/' : *p != *s)) {
+            return false;
+        }
+        s++;
+    }
+
+    return *s == '\0';
+}
+
+// Globs with a `/` are matched against the path relative to its root, the others
+// only against the file name, so `*.glsl` matches at any depth.
+bool path_matches(const String *glob, const char *relative_path) {
+    if (strchr(glob->data, '/') == NULL) {
+        const char *base = strrchr(relative_path, '/');
+        return glob_match(glob->data, base ? base + 1 : relative_path);
+    }
+    return glob_match(glob->data, relative_path);
+}
+
+u32 match_subscribers(const char *relative_path) {
+    for (isize i = 0; i < g_num_ignores; i++) {
+        if (path_matches(g_ignores[i], relative_path)) {
+            return 0;
+        }
+    }
+
+    u32 subscribers = 0;
+    for (isize s = 0; s < g_num_subscriptions; s++) {
+        for (isize i = 0; i < g_subscriptions[s].num_globs; i++) {
+            if (path_matches(g_subscriptions[s].globs[i], relative_path)) {
+                subscribers |= 1u << s;
+                break;
+            }
+        }
+    }
+    return subscribers;
+}
+
+WatcherEvent *watcher_peek_event(WatcherSubscription sub) {
+    LT_ASSERT(sub >= 0 && sub < g_num_subscriptions);
+    EventBuffer *buf = &g_subscriptions[sub].buffer;
+
+    usize tail = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+
+    // An empty poll costs two relaxed loads. The fence is only paid when there is an
+    // event, and pairs with the release in push_event. Empty polls still mark the
+    // previous events as processed, or names retired after the last event of a
+    // subscription would never be freed.
+    if (atomic_load_explicit(&buf->head, memory_order_relaxed) == tail) {
+        mark_processed(buf, tail);
         return NULL;
     }
+    atomic_thread_fence(memory_order_acquire);
+    mark_processed(buf, tail);
 
-    WatcherEvent *e = &g_event_buffer.events[g_event_buffer.tail];
+    return &buf->events[tail & (EVENT_BUFFER_LEN - 1)];
+}
 
-    pthread_mutex_unlock(&g_mutex_event_buffer);
-    return e;
+void watcher_event_peeked(WatcherSubscription sub) {
+    LT_ASSERT(sub >= 0 && sub < g_num_subscriptions);
+    consume_event(&g_subscriptions[sub].buffer);
 }
 
-void watcher_event_peeked() {
-    consume_event(&g_event_buffer);
+isize watcher_drain(WatcherSubscription sub, WatcherEvent *out, isize max) {
+    LT_ASSERT(sub >= 0 && sub < g_num_subscriptions);
+    EventBuffer *buf = &g_subscriptions[sub].buffer;
+
+    usize tail = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+    usize head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+
+    if (max <= 0) {
+        return 0;
+    }
+    // The previous batch has been processed, its names can be freed. Also when
+    // nothing new arrived, the subscription may never get another event.
+    mark_processed(buf, tail);
+    if (head == tail) {
+        return 0;
+    }
+    // A single fence covers the whole batch, pairs with the release in push_event.
+    atomic_thread_fence(memory_order_acquire);
+
+    isize count = lt_min((isize)(head - tail), max);
+    for (isize i = 0; i < count; i++) {
+        WatcherEvent *e = &buf->events[(tail + i) & (EVENT_BUFFER_LEN - 1)];
+        out[i] = *e;
+        e->inotify_mask = -1;
+        e->name = NULL;
+    }
+
+    // The slots are given back to the watcher all at once.
+    release_slots(buf, tail + count);
+    return count;
 }
 
-void watcher_stop() {
-    set_running(false);
+bool watcher_take_overflow(WatcherSubscription sub) {
+    LT_ASSERT(sub >= 0 && sub < g_num_subscriptions);
+    atomic_bool *overflowed = &g_subscriptions[sub].overflowed;
+
+    if (!atomic_load_explicit(overflowed, memory_order_relaxed)) {
+        return false;
+    }
+    return atomic_exchange_explicit(overflowed, false, memory_order_acquire);
 }
 
-void *watcher_start(void *arg) {
-    LT_UNUSED(arg);
+void watcher_get_stats(WatcherSubscription sub, WatcherStats *stats) {
+    LT_ASSERT(sub >= 0 && sub < g_num_subscriptions);
+    EventBuffer *buf = &g_subscriptions[sub].buffer;
+
+    usize tail = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+    usize head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+
+    stats->queue_depth = (isize)(head - tail);
+    stats->queue_high_water = atomic_load_explicit(&buf->high_water, memory_order_relaxed);
+    stats->delivered = atomic_load_explicit(&buf->delivered, memory_order_relaxed);
+    stats->coalesced = atomic_load_explicit(&g_coalesced, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&g_dropped, memory_order_relaxed);
+    stats->overflows = atomic_load_explicit(&g_overflows, memory_order_relaxed);
+}
+
+void watcher_dump_stats(FILE *fp) {
+    fprintf(fp, "Watcher queues:\n");
+
+    for (isize s = 0; s < g_num_subscriptions; s++) {
+        WatcherStats stats;
+        watcher_get_stats((WatcherSubscription)s, &stats);
+        fprintf(fp, "  subscription %ld: depth %ld, high water %ld/%d, delivered %llu\n",
+                (long)s, (long)stats.queue_depth, (long)stats.queue_high_water,
+                EVENT_BUFFER_LEN, (unsigned long long)stats.delivered);
+    }
+
+    fprintf(fp, "  coalesced %llu, dropped %llu, overflows %llu\n",
+            (unsigned long long)atomic_load(&g_coalesced),
+            (unsigned long long)atomic_load(&g_dropped),
+            (unsigned long long)atomic_load(&g_overflows));
+}
+
+void path_table_init(PathTable *t, isize capacity) {
+    LT_ASSERT((capacity & (capacity - 1)) == 0);
+
+    t->entries = calloc(capacity, sizeof(PathEntry));
+    t->capacity = capacity;
+    t->count = 0;
+    t->used = 0;
+}
+
+// Returns the entry of path, or NULL if it is not interned.
+PathEntry *path_table_find(const PathTable *t, const char *path, isize len, u64 hash) {
+    isize mask = t->capacity - 1;
+
+    for (isize i = (isize)(hash & (u64)mask); t->entries[i].path != NULL || t->entries[i].tombstone;
+         i = (i + 1) & mask) {
+        PathEntry *e = &t->entries[i];
+        if (e->path != NULL && e->hash == hash && e->path->len == len &&
+            memcmp(e->path->data, path, len) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Returns the interned copy of path, creating it the first time path is seen.
+// relative_path points inside path, past its root. The subscriptions are matched
+// before anything is allocated: paths nobody is interested in, like editor swap
+// files, are not interned and NULL is returned, unless a trace is being recorded.
+PathEntry *path_table_intern(PathTable *t, const char *path, isize len,
+                             const char *relative_path) {
+    u64 hash = lt_hash64(path, len, 0);
+    PathEntry *existing = path_table_find(t, path, len, hash);
+
+    if (existing) {
+        if (existing->mask_generation != g_mask_generation) {
+            existing->subscribers = match_subscribers(relative_path);
+            existing->mask_generation = g_mask_generation;
+        }
+        return existing;
+    }
+
+    u32 subscribers = match_subscribers(relative_path);
+    if (subscribers == 0 && g_trace == NULL) {
+        return NULL;
+    }
+
+    // Keep the load factor, tombstones included, under 1/2. Growing only moves the
+    // pointers, the interned strings themselves stay where they are. A table that
+    // is mostly tombstones is rebuilt at the same size.
+    if ((t->used + 1) * 2 > t->capacity) {
+        PathTable grown;
+        path_table_init(&grown, (t->count + 1) * 4 > t->capacity ? t->capacity * 2 : t->capacity);
+
+        for (isize j = 0; j < t->capacity; j++) {
+            if (t->entries[j].path != NULL) {
+                isize k = (isize)(t->entries[j].hash & (u64)(grown.capacity - 1));
+                while (grown.entries[k].path != NULL) {
+                    k = (k + 1) & (grown.capacity - 1);
+                }
+                grown.entries[k] = t->entries[j];
+                grown.count++;
+                grown.used++;
+            }
+        }
+        lt_free(t->entries);
+        *t = grown;
+    }
+
+    isize mask = t->capacity - 1;
+    isize i = (isize)(hash & (u64)mask);
+    while (t->entries[i].path != NULL && !t->entries[i].tombstone) {
+        i = (i + 1) & mask;
+    }
+    // Reusing a tombstone does not add to the probe sequences.
+    if (!t->entries[i].tombstone) {
+        t->used++;
+    }
+
+    memset(&t->entries[i], 0, sizeof(PathEntry));
+    t->entries[i].hash = hash;
+    t->entries[i].path = string_make(path);
+    t->entries[i].subscribers = subscribers;
+    t->entries[i].mask_generation = g_mask_generation;
+    t->count++;
+    return &t->entries[i];
+}
+
+// Removes the entry of a path that does not exist anymore. The other entries stay
+// where they are, so pointers to them remain valid.
+void path_table_remove(PathTable *t, PathEntry *e) {
+    LT_ASSERT(e->path != NULL);
+
+    RetiredPath retired = {0};
+    retired.path = e->path;
+    for (isize s = 0; s < g_num_subscriptions; s++) {
+        retired.heads[s] = atomic_load_explicit(&g_subscriptions[s].buffer.head,
+                                                memory_order_relaxed);
+    }
+    array_append(g_retired, retired);
+
+    memset(e, 0, sizeof(PathEntry));
+    e->tombstone = true;
+    t->count--;
+}
+
+// Frees the reclaimed names every consumer is done with.
+void free_retired_paths() {
+    isize kept = 0;
+
+    for (isize r = 0; r < array_length(g_retired); r++) {
+        RetiredPath *retired = &g_retired[r];
+        bool done = true;
+
+        for (isize s = 0; s < g_num_subscriptions && done; s++) {
+            // Acquire pairs with the release in mark_processed.
+            usize processed = atomic_load_explicit(&g_subscriptions[s].buffer.processed,
+                                                   memory_order_acquire);
+            // Free running counters, compared through their difference.
+            done = (isize)(processed - retired->heads[s]) >= 0;
+        }
+
+        if (done) {
+            string_free(retired->path);
+        } else {
+            g_retired[kept++] = *retired;
+        }
+    }
+    array_length(g_retired) = kept;
+}
+
+// Reclaims the entry of a path whose removal was just delivered, unless the poll
+// backend saw it again since.
+void reclaim_removed_path(const String *name) {
+    PathEntry *e = path_table_find(&g_paths, name->data, name->len,
+                                   lt_hash64(name->data, name->len, 0));
+    if (e && !e->present) {
+        path_table_remove(&g_paths, e);
+    }
+}
+
+// Drops every pending event and tells every consumer to rescan. Pending events
+// are redundant after a rescan, so this also gives the whole table back.
+void raise_overflow() {
+    for (isize i = 0; i < g_num_pending; i++) {
+        if (g_pending[i].removed) {
+            reclaim_removed_path(g_pending[i].name);
+        }
+    }
+
+    atomic_fetch_add_explicit(&g_dropped, (u64)g_num_pending, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_overflows, 1, memory_order_relaxed);
+    g_num_pending = 0;
+    g_buffer_full = false;
+
+    for (isize s = 0; s < g_num_subscriptions; s++) {
+        atomic_store_explicit(&g_subscriptions[s].overflowed, true, memory_order_release);
+    }
+}
+
+// Moves the pending event at index i into the event buffer of every interested
+// subscription. Returns false when one of the buffers is full, in which case the
+// event stays pending for the subscriptions that did not get it yet.
+bool flush_pending_at(isize i) {
+    LT_ASSERT(i >= 0 && i < g_num_pending);
+    PendingEvent *pe = &g_pending[i];
+
+    for (isize s = 0; s < g_num_subscriptions; s++) {
+        u32 bit = 1u << s;
+        if ((pe->subscribers & bit) &&
+            push_event(&g_subscriptions[s].buffer, pe->name, pe->mask, pe->first_ns)) {
+            pe->subscribers &= ~bit;
+        }
+    }
+
+    if (pe->subscribers != 0) {
+        return false;
+    }
+
+    if (pe->removed) {
+        reclaim_removed_path(pe->name);
+    }
+
+    // Keep the remaining events in arrival order.
+    memmove(&g_pending[i], &g_pending[i+1], sizeof(PendingEvent) * (g_num_pending - i - 1));
+    g_num_pending--;
+    return true;
+}
+
+// Flushes every pending event whose debounce window has elapsed.
+void flush_pending(u64 now_ns) {
+    g_buffer_full = false;
+    g_flushed_ns = now_ns;
+
+    isize i = 0;
+    while (i < g_num_pending) {
+        if (g_pending[i].deadline_ns > now_ns) {
+            i++;
+        } else if (!flush_pending_at(i)) {
+            // A consumer is behind, retry once it made room.
+            g_buffer_full = true;
+            i++;
+        }
+    }
+}
+
+// Reads the whole file into a new buffer. The file may be written again while it is
+// read, so the size is whatever could be read. Returns NULL on failure.
+u8 *trace_read_snapshot(const char *path, u32 *len) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fileno(fp), &st) < 0 || !S_ISREG(st.st_mode) || st.st_size >= UINT32_MAX) {
+        fclose(fp);
+        return NULL;
+    }
+
+    u8 *data = malloc(lt_max((usize)st.st_size, (usize)1));
+    *len = (u32)fread(data, 1, (usize)st.st_size, fp);
+    fclose(fp);
+    return data;
+}
+
+void trace_write_record(u64 now_ns, u32 mask, isize root, const char *relative_path,
+                        isize path_len, const u8 *contents, u32 contents_len) {
+    TraceRecord rec = {0};
+    rec.time_ns = now_ns - g_trace_start_ns;
+    rec.mask = mask;
+    rec.contents_len = contents ? contents_len : TRACE_NO_CONTENTS;
+    rec.root = (u16)root;
+    rec.path_len = (u16)path_len;
+
+    fwrite(&rec, sizeof(rec), 1, g_trace);
+    fwrite(relative_path, 1, path_len, g_trace);
+    if (contents) {
+        fwrite(contents, 1, contents_len, g_trace);
+    }
+}
+
+// Appends the event to the trace being recorded, if any.
+void trace_record(const PathEntry *entry, u32 mask, u64 now_ns) {
+    if (g_trace == NULL) {
+        return;
+    }
+
+    // Roots can be nested, the path belongs to the longest one.
+    const String *path = entry->path;
+    isize root = -1;
+    for (isize r = 0; r < g_num_roots; r++) {
+        isize len = g_roots[r]->len;
+        if (path->len > len && path->data[len] == '/' &&
+            memcmp(path->data, g_roots[r]->data, len) == 0 &&
+            (root < 0 || len > g_roots[root]->len)) {
+            root = r;
+        }
+    }
+    if (root < 0) {
+        return;
+    }
+
+    const char *relative_path = path->data + g_roots[root]->len + 1;
+    u8 *contents = NULL;
+    u32 contents_len = 0;
+
+    if (g_trace_contents && (mask & WATCHER_FILE_CHANGED) && !(mask & IN_ISDIR)) {
+        contents = trace_read_snapshot(path->data, &contents_len);
+    }
+
+    trace_write_record(now_ns, mask, root, relative_path, strlen(relative_path),
+                       contents, contents_len);
+    lt_free(contents);
+}
+
+// Merges the event into the pending entry of the same path, or creates a new one.
+void add_pending(PathEntry *entry, u32 mask, u64 now_ns) {
+    const String *name = entry->path;
+    bool removed = (mask & (IN_DELETE|IN_MOVED_FROM)) != 0;
+
+    trace_record(entry, mask, now_ns);
+
+    // Ignored, or nobody is interested in it, the path was only interned for the trace.
+    if (entry->subscribers == 0) {
+        if (removed && !entry->present) {
+            path_table_remove(&g_paths, entry);
+        }
+        return;
+    }
+
+    for (isize i = 0; i < g_num_pending; i++) {
+        PendingEvent *pe = &g_pending[i];
+
+        // Names are interned, so equal paths share the same pointer.
+        if (pe->name == name) {
+            // A file removed after being written has no contents to report anymore.
+            if (mask & (IN_DELETE|IN_MOVED_FROM)) {
+                pe->mask &= ~(u32)WATCHER_FILE_CHANGED;
+            }
+            pe->mask |= mask;
+            pe->removed = removed;
+            atomic_fetch_add_explicit(&g_coalesced, 1, memory_order_relaxed);
+            // Subscriptions that already got the older event need the new one too.
+            pe->subscribers = entry->subscribers;
+            pe->deadline_ns = lt_min(now_ns + g_debounce_ns,
+                                     pe->first_ns + MAX_DEBOUNCE_WINDOWS * g_debounce_ns);
+            return;
+        }
+    }
+
+    if (g_num_pending == MAX_PENDING) {
+        // Out of room, the oldest path is delivered before its window ends. If the
+        // event buffer is full as well, nothing can be kept and the consumer has to
+        // rescan.
+        if (!flush_pending_at(0)) {
+            raise_overflow();
+            atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+            return;
+        }
+    }
+
+    PendingEvent *pe = &g_pending[g_num_pending++];
+    pe->name = name;
+    pe->mask = mask;
+    pe->subscribers = entry->subscribers;
+    pe->first_ns = now_ns;
+    pe->deadline_ns = now_ns + g_debounce_ns;
+    pe->removed = removed;
+}
+
+// Returns the wait timeout in milliseconds until the next pending deadline. Events
+// left pending by a full event buffer have no deadline anymore, the consumer wakes
+// the thread up through the room descriptor once there is room for them.
+i32 pending_timeout_ms(u64 now_ns) {
+    i32 timeout_ms = -1;
+
+    for (isize i = 0; i < g_num_pending; i++) {
+        u64 deadline_ns = g_pending[i].deadline_ns;
+
+        if (g_buffer_full && deadline_ns <= g_flushed_ns) {
+            continue;
+        }
+        if (deadline_ns <= now_ns) {
+            return 0;
+        }
+        // Round up, otherwise the thread wakes up just before the deadline.
+        i32 ms = (i32)((deadline_ns - now_ns + 999999) / 1000000);
+        timeout_ms = timeout_ms < 0 ? ms : lt_min(timeout_ms, ms);
+    }
+    return timeout_ms;
+}
+
+#ifdef __linux__
+isize watch_table_slot(const WatchTable *t, i32 wd) {
+    // Fibonacci hashing spreads the small sequential descriptors over the table.
+    return (isize)(((u32)wd * 2654435761u) & (u32)(t->capacity - 1));
+}
+
+void watch_table_init(WatchTable *t, isize capacity) {
+    LT_ASSERT((capacity & (capacity - 1)) == 0);
+
+    t->entries = malloc(sizeof(WatchEntry) * capacity);
+    t->capacity = capacity;
+    t->count = 0;
+
+    for (isize i = 0; i < capacity; i++) {
+        t->entries[i].wd = -1;
+        t->entries[i].path = NULL;
+    }
+}
+
+void watch_table_free(WatchTable *t) {
+    for (isize i = 0; i < t->capacity; i++) {
+        if (t->entries[i].wd != -1) {
+            string_free(t->entries[i].path);
+        }
+    }
+    lt_free(t->entries);
+    t->capacity = 0;
+    t->count = 0;
+}
+
+WatchEntry *watch_table_get(WatchTable *t, i32 wd) {
+    isize mask = t->capacity - 1;
+    for (isize i = watch_table_slot(t, wd); t->entries[i].wd != -1; i = (i + 1) & mask) {
+        if (t->entries[i].wd == wd) {
+            return &t->entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Takes ownership of path. Adding the same descriptor twice replaces its path.
+void watch_table_put(WatchTable *t, i32 wd, String *path, isize root_len) {
+    WatchEntry *existing = watch_table_get(t, wd);
+    if (existing) {
+        string_free(existing->path);
+        existing->path = path;
+        existing->root_len = root_len;
+        return;
+    }
+
+    // Keep the load factor under 1/2, so probe sequences stay short.
+    if ((t->count + 1) * 2 > t->capacity) {
+        WatchTable grown;
+        watch_table_init(&grown, t->capacity * 2);
+
+        for (isize i = 0; i < t->capacity; i++) {
+            if (t->entries[i].wd != -1) {
+                watch_table_put(&grown, t->entries[i].wd, t->entries[i].path,
+                                t->entries[i].root_len);
+            }
+        }
+        lt_free(t->entries);
+        *t = grown;
+    }
+
+    isize i = watch_table_slot(t, wd);
+    while (t->entries[i].wd != -1) {
+        i = (i + 1) & (t->capacity - 1);
+    }
+    t->entries[i].wd = wd;
+    t->entries[i].path = path;
+    t->entries[i].root_len = root_len;
+    t->count++;
+}
+
+void watch_table_remove(WatchTable *t, i32 wd) {
+    WatchEntry *entry = watch_table_get(t, wd);
+    if (!entry) {
+        return;
+    }
+
+    isize mask = t->capacity - 1;
+    isize hole = entry - t->entries;
+    string_free(entry->path);
+    entry->wd = -1;
+    t->count--;
+
+    // Shift the following entries of the cluster back, so lookups never stop early
+    // at the hole.
+    for (isize i = (hole + 1) & mask; t->entries[i].wd != -1; i = (i + 1) & mask) {
+        isize home = watch_table_slot(t, t->entries[i].wd);
+        bool movable = (hole <= i) ? (home <= hole || home > i) : (home <= hole && home > i);
+
+        if (movable) {
+            t->entries[hole] = t->entries[i];
+            t->entries[i].wd = -1;
+            t->entries[i].path = NULL;
+            hole = i;
+        }
+    }
+}
+
+// Watches path and every directory below it. The first root_len characters of
+// path are its root. With report set, which is used for directories that appear
+// while watching, everything already inside is queued as created, since no event
+// will ever be seen for it. Returns false if path itself could not be watched.
+bool add_watch_tree(i32 fd, const char *path, isize root_len, bool report, u64 now_ns) {
+    i32 wd = inotify_add_watch(fd, path, WATCH_MASK|IN_ONLYDIR);
+
+    if (wd < 0) {
+        return false;
+    }
+    // The directory is watched before being listed, so entries created in the
+    // meantime show up as IN_CREATE events instead of being missed.
+    watch_table_put(&g_watches, wd, string_make(path), root_len);
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return true;
+    }
+
+    char child[PATH_MAX];
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
 
-    const isize MAX_NUM_EVENTS = 10;
+        i32 n = snprintf(child, sizeof(child), "%s/%s", path, de->d_name);
+        struct stat st;
 
-    // Initialize the mutexes.
-    pthread_mutex_init(&g_mutex_running, NULL);
-    pthread_mutex_init(&g_mutex_event_buffer, NULL);
-    // Initialize the event buffer with maximum number of events.
-    initialize_event_buffer(&g_event_buffer, MAX_NUM_EVENTS);
+        // Symbolic links are not followed, so the walk can not loop.
+        if (n >= (i32)sizeof(child) || lstat(child, &st) < 0) {
+            continue;
+        }
+
+        if (report && (S_ISDIR(st.st_mode) || S_ISREG(st.st_mode))) {
+            PathEntry *entry = path_table_intern(&g_paths, child, n, child + root_len + 1);
+            if (entry) {
+                add_pending(entry, S_ISDIR(st.st_mode) ? IN_CREATE|IN_ISDIR
+                                                       : IN_CREATE|IN_CLOSE_WRITE, now_ns);
+            }
+        }
 
-    i32 fd = inotify_init1(IN_NONBLOCK);
+        if (S_ISDIR(st.st_mode) && !add_watch_tree(fd, child, root_len, report, now_ns)) {
+            fprintf(stderr, "Could not add watch to %s\n", child);
+        }
+    }
+    closedir(dir);
+
+    return true;
+}
+
+// Stops watching path and every directory below it. Used when the directory is moved
+// away, its watches would keep reporting events under the old path. If it was moved
+// inside a root, it is watched again from its new path on IN_MOVED_TO.
+void remove_watch_tree(i32 fd, const char *path, isize len) {
+    isize i = 0;
+
+    while (i < g_watches.capacity) {
+        WatchEntry *e = &g_watches.entries[i];
+
+        if (e->wd != -1 && e->path->len >= len && memcmp(e->path->data, path, len) == 0 &&
+            (e->path->len == len || e->path->data[len] == '/')) {
+            inotify_rm_watch(fd, e->wd);
+            // Following entries are shifted back into the slot, look at it again.
+            watch_table_remove(&g_watches, e->wd);
+        } else {
+            i++;
+        }
+    }
+}
+
+void handle_inotify_event(i32 fd, const struct inotify_event *event, u64 now_ns) {
+    if (event->mask & IN_Q_OVERFLOW) {
+        // The kernel queue overflowed and events were lost.
+        if (g_trace) {
+            trace_write_record(now_ns, IN_Q_OVERFLOW, 0, "", 0, NULL, 0);
+        }
+        raise_overflow();
+        atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    if (event->mask & IN_IGNORED) {
+        // The directory was removed or unmounted.
+        watch_table_remove(&g_watches, event->wd);
+        return;
+    }
+
+    WatchEntry *dir = watch_table_get(&g_watches, event->wd);
+
+    if (event->len == 0 || dir == NULL) {
+        return;
+    }
+
+    // The name is copied straight out of the kernel record. It is padded with
+    // zeroes up to event->len, so its real length is bounded by it.
+    isize dir_len = dir->path->len;
+    isize name_len = strnlen(event->name, event->len);
+
+    if (dir_len + 1 + name_len >= PATH_MAX) {
+        fprintf(stderr, "Path too long inside %s, IGNORING.\n", dir->path->data);
+        return;
+    }
+
+    char path[PATH_MAX];
+    memcpy(path, dir->path->data, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, event->name, name_len);
+    path[dir_len + 1 + name_len] = '\0';
+
+    // Adding or removing watches moves the entries of the table around, dir can
+    // not be used past this point.
+    isize root_len = dir->root_len;
+
+    // Coalesce the event with the others on the same path. Ignored paths are not
+    // even interned.
+    PathEntry *entry = path_table_intern(&g_paths, path, dir_len + 1 + name_len,
+                                         path + root_len + 1);
+    if (entry) {
+        add_pending(entry, event->mask, now_ns);
+    }
+
+    if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE|IN_MOVED_TO))) {
+        // Start watching new or moved in subdirectories as well, and report what
+        // they already contain.
+        if (!add_watch_tree(fd, path, root_len, true, now_ns)) {
+            fprintf(stderr, "Could not add watch to %s\n", path);
+        }
+    } else if ((event->mask & IN_ISDIR) && (event->mask & IN_MOVED_FROM)) {
+        remove_watch_tree(fd, path, dir_len + 1 + name_len);
+    }
+}
+
+void run_inotify_backend(String **roots, isize num_roots) {
+    i32 fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
 
     if (fd < 0) {
-        pthread_mutex_destroy(&g_mutex_running);
-        pthread_mutex_destroy(&g_mutex_event_buffer);
         LT_FAIL("Failed starting inotify.\n");
     }
 
-    i32 wd = inotify_add_watch((i32)fd, PATH, IN_MODIFY|IN_CREATE|IN_DELETE);
+    watch_table_init(&g_watches, 64);
 
-    if (wd < 0) {
-        pthread_mutex_destroy(&g_mutex_running);
-        pthread_mutex_destroy(&g_mutex_event_buffer);
-        LT_FAIL("Could not add watch to %s\n", PATH);
+    for (isize r = 0; r < num_roots; r++) {
+        if (!add_watch_tree(fd, roots[r]->data, roots[r]->len, false, 0)) {
+            LT_FAIL("Could not add watch to %s\n", roots[r]->data);
+        }
+        printf("Watching folder %s\n", roots[r]->data);
+    }
+
+    // The thread sleeps on both the inotify descriptor and the wakeup eventfd,
+    // so it uses no CPU while idle and returns as soon as watcher_stop is called.
+    i32 epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (epfd < 0) {
+        LT_FAIL("Failed creating epoll instance.\n");
     }
 
-    char buf[BUF_LEN] = {0};
+    {
+        struct epoll_event ev = {0};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            LT_FAIL("Failed adding the inotify descriptor to epoll.\n");
+        }
 
-    set_running(true);
+        ev.data.fd = g_wakeup_fd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, g_wakeup_fd, &ev) < 0) {
+            LT_FAIL("Failed adding the wakeup descriptor to epoll.\n");
+        }
+
+        ev.data.fd = g_room_fd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, g_room_fd, &ev) < 0) {
+            LT_FAIL("Failed adding the room descriptor to epoll.\n");
+        }
+    }
 
-    printf("Watching folder %s\n", PATH);
-    while (g_running) {
-        memset(buf, 0, BUF_LEN);
-        isize i = 0;
-        isize len = read(fd, buf, BUF_LEN);
+    // Not cleared between reads, only the bytes returned by read are looked at.
+    _Alignas(struct inotify_event) char buf[BUF_LEN];
 
-        if (len < 0) {
-            if (errno == EAGAIN) {
+    bool running = true;
+
+    while (running) {
+        struct epoll_event ready[3];
+        i32 num_ready = epoll_wait(epfd, ready, 3, pending_timeout_ms(time_now_ns()));
+
+        if (num_ready < 0) {
+            if (errno != EINTR) {
+                perror("Error waiting for inotify events");
+            }
+            continue;
+        }
+
+        for (i32 r = 0; r < num_ready; r++) {
+            if (ready[r].data.fd == g_wakeup_fd) {
+                running = false;
                 continue;
-            } else {
+            }
+            // A consumer made room, the flush below retries.
+            if (ready[r].data.fd == g_room_fd) {
+                clear_room_fd();
+                continue;
+            }
+
+            // Drain everything the kernel has queued before flushing, so a burst
+            // is coalesced as a whole.
+            isize len;
+            while ((len = read(fd, buf, BUF_LEN)) > 0) {
+                u64 now_ns = time_now_ns();
+                isize i = 0;
+
+                while (i < len) {
+                    const struct inotify_event *event = (const struct inotify_event *)&buf[i];
+                    handle_inotify_event(fd, event, now_ns);
+                    i += EVENT_SIZE + event->len;
+                }
+            }
+
+            if (len < 0 && errno != EAGAIN) {
                 perror("Error reading for inotify event");
+            }
+        }
+
+        flush_pending(time_now_ns());
+        free_retired_paths();
+    }
+    printf("Finished watching %ld folders\n", (long)g_watches.count);
+
+    close(epfd);
+    // Closing the inotify descriptor removes every watch.
+    close(fd);
+    watch_table_free(&g_watches);
+}
+#endif // __linux__
+
+u64 stat_mtime_ns(const struct stat *st) {
+#if defined(__APPLE__)
+    return (u64)st->st_mtimespec.tv_sec * 1000000000ull + (u64)st->st_mtimespec.tv_nsec;
+#else
+    return (u64)st->st_mtim.tv_sec * 1000000000ull + (u64)st->st_mtim.tv_nsec;
+#endif
+}
+
+// Compares the metadata of an entry with the last scan. Changed files are only
+// reported once their metadata is the same on two scans in a row, so a file that
+// is still being written is never reported. Returns true if the entry changed or
+// is still settling.
+bool poll_check_entry(PathEntry *e, const struct stat *st, u32 generation, bool report,
+                      u64 now_ns) {
+    bool is_dir = S_ISDIR(st->st_mode);
+    u64 mtime_ns = stat_mtime_ns(st);
+
+    e->scan_generation = generation;
+
+    if (!e->present) {
+        e->present = true;
+        e->is_dir = is_dir;
+        e->ino = (u64)st->st_ino;
+        e->size = (u64)st->st_size;
+        e->mtime_ns = mtime_ns;
+
+        if (report) {
+            if (is_dir) {
+                add_pending(e, IN_CREATE|IN_ISDIR, now_ns);
+            } else {
+                e->settling_mask = IN_CREATE|IN_CLOSE_WRITE;
+            }
+            return true;
+        }
+    } else if (e->ino != (u64)st->st_ino || e->size != (u64)st->st_size || e->mtime_ns != mtime_ns) {
+        e->ino = (u64)st->st_ino;
+        e->size = (u64)st->st_size;
+        e->mtime_ns = mtime_ns;
+
+        if (report && !is_dir) {
+            e->settling_mask |= IN_CLOSE_WRITE;
+            return true;
+        }
+    } else if (e->settling_mask != 0) {
+        u32 settled_mask = e->settling_mask;
+        e->settling_mask = 0;
+        add_pending(e, settled_mask, now_ns);
+        return true;
+    }
+    return false;
+}
+
+// Compares the metadata of every entry below path with the last scan. Nothing is
+// reported when report is false, which is used to take the initial snapshot.
+// Returns true if anything changed or is still settling.
+bool poll_scan_tree(const char *path, isize root_len, u32 generation, bool report, u64 now_ns) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return false;
+    }
+
+    bool changed = false;
+    char child[PATH_MAX];
+    struct dirent *de;
+
+    while ((de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+
+        i32 n = snprintf(child, sizeof(child), "%s/%s", path, de->d_name);
+        struct stat st;
+
+        // Symbolic links are not followed, so the walk can not loop.
+        if (n >= (i32)sizeof(child) || lstat(child, &st) < 0) {
+            continue;
+        }
+
+        PathEntry *e = path_table_intern(&g_paths, child, n, child + root_len + 1);
+
+        // Ignored paths are not tracked, but ignored directories are still walked.
+        if (e) {
+            changed |= poll_check_entry(e, &st, generation, report, now_ns);
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            changed |= poll_scan_tree(child, root_len, generation, report, now_ns);
+        }
+    }
+    closedir(dir);
+
+    return changed;
+}
+
+// Reports every entry that was present before, but not seen by the scan.
+bool poll_report_deleted(u32 generation, u64 now_ns) {
+    bool changed = false;
+
+    for (isize i = 0; i < g_paths.capacity; i++) {
+        PathEntry *e = &g_paths.entries[i];
+
+        if (e->path != NULL && e->present && e->scan_generation != generation) {
+            e->present = false;
+            e->settling_mask = 0;
+            add_pending(e, e->is_dir ? IN_DELETE|IN_ISDIR : IN_DELETE, now_ns);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void run_poll_backend(const WatcherConfig *config, String **roots, isize num_roots) {
+    u64 min_interval_ns = (u64)(config->poll_min_interval_ms > 0
+                                ? config->poll_min_interval_ms
+                                : WATCHER_DEFAULT_POLL_MIN_INTERVAL_MS) * 1000000ull;
+    u64 max_interval_ns = (u64)(config->poll_max_interval_ms > 0
+                                ? config->poll_max_interval_ms
+                                : WATCHER_DEFAULT_POLL_MAX_INTERVAL_MS) * 1000000ull;
+    u64 cpu_budget = (u64)(config->poll_cpu_budget_percent > 0
+                           ? config->poll_cpu_budget_percent
+                           : WATCHER_DEFAULT_POLL_CPU_BUDGET_PERCENT);
+    max_interval_ns = lt_max(max_interval_ns, min_interval_ns);
+
+    u32 generation = 1;
+    u64 interval_ns = min_interval_ns;
+
+    // Take the initial snapshot, the files are there already and not reported.
+    for (isize r = 0; r < num_roots; r++) {
+        poll_scan_tree(roots[r]->data, roots[r]->len, generation, false, time_now_ns());
+        printf("Polling folder %s\n", roots[r]->data);
+    }
+    u64 next_scan_ns = time_now_ns() + interval_ns;
+
+    // Woken up by watcher_stop, or by a consumer that made room.
+    struct pollfd wakeup[2] = {0};
+    wakeup[0].fd = g_wakeup_fd;
+    wakeup[0].events = POLLIN;
+    wakeup[1].fd = g_room_fd;
+    wakeup[1].events = POLLIN;
+
+    bool running = true;
+
+    while (running) {
+        u64 now_ns = time_now_ns();
+
+        if (now_ns >= next_scan_ns) {
+            u64 cpu_start_ns = thread_cpu_ns();
+            bool changed = false;
+
+            generation++;
+            for (isize r = 0; r < num_roots; r++) {
+                changed |= poll_scan_tree(roots[r]->data, roots[r]->len, generation, true, now_ns);
+            }
+            changed |= poll_report_deleted(generation, now_ns);
+
+            // Back off while nothing happens, and look again quickly after a change,
+            // since editors tend to touch the same files again.
+            interval_ns = changed ? min_interval_ns : lt_min(interval_ns * 2, max_interval_ns);
+
+            // Scanning big trees is not free, stretch the interval so the time spent
+            // scanning stays inside the CPU budget.
+            u64 scan_cpu_ns = thread_cpu_ns() - cpu_start_ns;
+            interval_ns = lt_max(interval_ns, scan_cpu_ns * 100 / cpu_budget);
+
+            now_ns = time_now_ns();
+            next_scan_ns = now_ns + interval_ns;
+        }
+
+        flush_pending(now_ns);
+        free_retired_paths();
+
+        i32 timeout_ms = (i32)((next_scan_ns - now_ns + 999999) / 1000000);
+        i32 pending_ms = pending_timeout_ms(now_ns);
+        if (pending_ms >= 0) {
+            timeout_ms = lt_min(timeout_ms, pending_ms);
+        }
+
+        i32 num_ready = poll(wakeup, 2, timeout_ms);
+
+        if (num_ready < 0 && errno != EINTR) {
+            perror("Error waiting for the next scan");
+        } else if (num_ready > 0) {
+            running = !(wakeup[0].revents & POLLIN);
+            if (wakeup[1].revents & POLLIN) {
+                clear_room_fd();
+            }
+        }
+    }
+    printf("Finished polling, last interval %ldms\n", (long)(interval_ns / 1000000));
+
+    // The next run starts from a fresh snapshot.
+    for (isize i = 0; i < g_paths.capacity; i++) {
+        g_paths.entries[i].present = false;
+        g_paths.entries[i].settling_mask = 0;
+    }
+}
+
+void watcher_stop() {
+    pthread_once(&g_wakeup_once, initialize_wakeup_fd);
+
+    u64 one = 1;
+    if (write(g_wakeup_write_fd, &one, sizeof(one)) < 0) {
+        perror("Error signaling the watcher thread");
+    }
+}
+
+// Reads the next record of the trace. The path is stored in path and the snapshot,
+// if any, in a new buffer returned through contents. Returns false at the end of the
+// trace or when it is truncated.
+bool trace_read_record(FILE *fp, TraceRecord *rec, char *path, u8 **contents) {
+    *contents = NULL;
+
+    if (fread(rec, sizeof(*rec), 1, fp) != 1 || rec->path_len >= PATH_MAX ||
+        fread(path, 1, rec->path_len, fp) != rec->path_len) {
+        return false;
+    }
+    path[rec->path_len] = '\0';
+
+    if (rec->contents_len != TRACE_NO_CONTENTS) {
+        *contents = malloc(lt_max((usize)rec->contents_len, (usize)1));
+        if (fread(*contents, 1, rec->contents_len, fp) != rec->contents_len) {
+            lt_free(*contents);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Removes the file, or the directory with what is left in it: a directory moved away
+// is recorded without events for its contents. Returns false on error.
+bool replay_remove(const char *path, bool is_dir) {
+    if (!is_dir) {
+        return unlink(path) == 0 || errno == ENOENT;
+    }
+
+    DIR *dir = opendir(path);
+    if (dir != NULL) {
+        char child[PATH_MAX];
+        struct dirent *de;
+        while ((de = readdir(dir)) != NULL) {
+            if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
                 continue;
             }
+
+            i32 n = snprintf(child, sizeof(child), "%s/%s", path, de->d_name);
+            struct stat st;
+
+            // Symbolic links are removed, not followed.
+            if (n < (i32)sizeof(child) && lstat(child, &st) == 0) {
+                replay_remove(child, S_ISDIR(st.st_mode));
+            }
+        }
+        closedir(dir);
+    }
+    return rmdir(path) == 0 || errno == ENOENT;
+}
+
+// Restores the recorded state of the file, and feeds the event to the subscriptions
+// as if a backend had just seen it.
+void replay_record(const TraceRecord *rec, const char *relative_path, const u8 *contents,
+                   bool has_contents, String **roots, isize num_roots, u64 now_ns) {
+    if (rec->mask & IN_Q_OVERFLOW) {
+        raise_overflow();
+        atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    if (rec->root >= num_roots) {
+        return;
+    }
+
+    char path[PATH_MAX];
+    i32 n = snprintf(path, sizeof(path), "%s/%s", roots[rec->root]->data, relative_path);
+    if (n >= (i32)sizeof(path)) {
+        fprintf(stderr, "Path too long in trace %s, IGNORING.\n", relative_path);
+        return;
+    }
+
+    // Traces with snapshots recreate the files, so the consumer reads what was
+    // recorded. Directories have no snapshot, they are created as well. Removed
+    // files are removed again, so the replayed tree does not drift from the recorded one.
+    if (has_contents && (rec->mask & IN_ISDIR) && (rec->mask & (IN_CREATE|IN_MOVED_TO))) {
+        if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+            fprintf(stderr, "Could not create directory %s\n", path);
+        }
+    }
+    if (has_contents && (rec->mask & (IN_DELETE|IN_MOVED_FROM))) {
+        if (!replay_remove(path, (rec->mask & IN_ISDIR) != 0)) {
+            fprintf(stderr, "Could not remove %s\n", path);
+        }
+    }
+
+    if (contents) {
+        FILE *fp = fopen(path, "wb");
+        if (fp == NULL || fwrite(contents, 1, rec->contents_len, fp) != rec->contents_len) {
+            fprintf(stderr, "Could not restore %s\n", path);
+        }
+        if (fp) {
+            fclose(fp);
+        }
+    }
+
+    PathEntry *entry = path_table_intern(&g_paths, path, n, path + roots[rec->root]->len + 1);
+    if (entry) {
+        add_pending(entry, rec->mask, now_ns);
+    }
+}
+
+void run_replay_backend(const WatcherConfig *config, String **roots, isize num_roots) {
+    FILE *fp = NULL;
+    TraceHeader header = {0};
+
+    if (config->replay_path == NULL || (fp = fopen(config->replay_path, "rb")) == NULL) {
+        fprintf(stderr, "Could not open trace %s\n",
+                config->replay_path ? config->replay_path : "(null)");
+    } else if (fread(&header, sizeof(header), 1, fp) != 1 ||
+               memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+               header.version != TRACE_VERSION) {
+        fprintf(stderr, "%s is not a watcher trace\n", config->replay_path);
+        fclose(fp);
+        fp = NULL;
+    } else {
+        if (header.num_roots > (u32)num_roots) {
+            printf("Trace has %u roots, only replaying events of the first %ld\n",
+                   header.num_roots, (long)num_roots);
+        }
+        printf("Replaying trace %s\n", config->replay_path);
+    }
+
+    f64 speed = config->replay_speed == 0.0f ? 1.0 : (f64)config->replay_speed;
+    bool has_contents = (header.flags & TRACE_FLAG_CONTENTS) != 0;
+
+    TraceRecord rec;
+    char relative_path[PATH_MAX];
+    u8 *contents = NULL;
+    bool has_record = fp && trace_read_record(fp, &rec, relative_path, &contents);
+    isize num_replayed = 0;
+
+    // Woken up by watcher_stop, or by a consumer that made room.
+    struct pollfd wakeup[2] = {0};
+    wakeup[0].fd = g_wakeup_fd;
+    wakeup[0].events = POLLIN;
+    wakeup[1].fd = g_room_fd;
+    wakeup[1].events = POLLIN;
+
+    u64 start_ns = time_now_ns();
+    bool running = true;
+
+    while (running) {
+        u64 now_ns = time_now_ns();
+
+        // Everything due is replayed before flushing, so bursts coalesce like they
+        // did when they were recorded.
+        while (has_record) {
+            u64 due_ns = speed < 0.0 ? start_ns : start_ns + (u64)((f64)rec.time_ns / speed);
+            if (due_ns > now_ns) {
+                break;
+            }
+
+            replay_record(&rec, relative_path, contents, has_contents, roots, num_roots, now_ns);
+            num_replayed++;
+            lt_free(contents);
+            has_record = trace_read_record(fp, &rec, relative_path, &contents);
+
+            if (!has_record) {
+                printf("Finished replaying %ld events\n", (long)num_replayed);
+            }
         }
 
-        LT_ASSERT(len < (isize)BUF_LEN);
+        flush_pending(now_ns);
+        free_retired_paths();
 
-        while (i < len) {
-            struct inotify_event *event = (struct inotify_event *)&buf[i];
+        i32 timeout_ms = pending_timeout_ms(now_ns);
+        if (has_record) {
+            u64 due_ns = speed < 0.0 ? start_ns : start_ns + (u64)((f64)rec.time_ns / speed);
+            i32 record_ms = due_ns > now_ns ? (i32)((due_ns - now_ns + 999999) / 1000000) : 0;
+            timeout_ms = timeout_ms < 0 ? record_ms : lt_min(timeout_ms, record_ms);
+        }
+
+        // Once the trace is over the thread just waits to be stopped.
+        i32 num_ready = poll(wakeup, 2, timeout_ms);
 
-            if (event->len) {
-                // Push event to the circular buffer.
-                push_event(&g_event_buffer, event);
+        if (num_ready < 0 && errno != EINTR) {
+            perror("Error waiting for the next trace event");
+        } else if (num_ready > 0) {
+            running = !(wakeup[0].revents & POLLIN);
+            if (wakeup[1].revents & POLLIN) {
+                clear_room_fd();
             }
+        }
+    }
+
+    lt_free(contents);
+    if (fp) {
+        fclose(fp);
+    }
+}
+
+void *watcher_start(void *arg) {
+    const WatcherConfig *config = arg;
+    WatcherConfig default_config = {0};
+
+    if (config == NULL) {
+        default_config.debounce_ms = WATCHER_DEFAULT_DEBOUNCE_MS;
+        config = &default_config;
+    }
+
+    g_debounce_ns = (u64)lt_max(config->debounce_ms, 0) * 1000000ull;
+    g_num_pending = 0;
+    g_buffer_full = false;
+    g_mask_generation++;
+    atomic_store(&g_started, true);
+
+    pthread_once(&g_wakeup_once, initialize_wakeup_fd);
+
+    // The path table survives restarts, names of old events must stay valid.
+    if (g_paths.entries == NULL) {
+        path_table_init(&g_paths, 256);
+        array_init(g_retired);
+    }
+
+    const char *default_roots[] = { PATH };
+    const char *const *root_names = default_roots;
+    isize num_roots = 1;
+
+    if (config->num_roots > 0) {
+        root_names = config->roots;
+        num_roots = config->num_roots;
+    }
 
-            i += EVENT_SIZE + event->len;
+    String **roots = malloc(sizeof(String*) * num_roots);
+    for (isize r = 0; r < num_roots; r++) {
+        // Strip trailing slashes, event paths are joined with one.
+        roots[r] = string_make(root_names[r]);
+        while (roots[r]->len > 1 && roots[r]->data[roots[r]->len - 1] == '/') {
+            roots[r]->data[--roots[r]->len] = '\0';
         }
     }
-    printf("Finished watching folder %s\n", PATH);
+
+    g_roots = roots;
+    g_num_roots = num_roots;
+
+    if (config->record_path) {
+        g_trace = fopen(config->record_path, "wb");
+
+        if (g_trace == NULL) {
+            fprintf(stderr, "Could not open trace %s for recording\n", config->record_path);
+        } else {
+            TraceHeader header = {0};
+            memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+            header.version = TRACE_VERSION;
+            header.flags = config->record_contents ? TRACE_FLAG_CONTENTS : 0;
+            header.num_roots = (u32)num_roots;
+            fwrite(&header, sizeof(header), 1, g_trace);
+
+            g_trace_contents = config->record_contents;
+            g_trace_start_ns = time_now_ns();
+            printf("Recording watcher trace to %s\n", config->record_path);
+        }
+    }
+
+    WatcherBackend backend = config->backend;
+#ifndef __linux__
+    if (backend == WatcherBackend_Inotify) {
+        printf("inotify is not available, falling back to polling\n");
+        backend = WatcherBackend_Poll;
+    }
+#endif
+
+    switch (backend) {
+#ifdef __linux__
+    case WatcherBackend_Inotify:
+        run_inotify_backend(roots, num_roots);
+        break;
+#endif
+    case WatcherBackend_Poll:
+        run_poll_backend(config, roots, num_roots);
+        break;
+
+    case WatcherBackend_Replay:
+        run_replay_backend(config, roots, num_roots);
+        break;
+
+    default:
+        LT_ASSERT(false);
+    }
+
+    // Reset the wakeup counter, so the watcher can be started again.
+    {
+        u64 count;
+        isize unused = read(g_wakeup_fd, &count, sizeof(count));
+        LT_UNUSED(unused);
+    }
+
+    watcher_dump_stats(stdout);
 
     // Cleanup resources.
-    inotify_rm_watch(fd, wd);
-    close(fd);
-    free_event_buffer(&g_event_buffer);
-    pthread_mutex_destroy(&g_mutex_running);
-    pthread_mutex_destroy(&g_mutex_event_buffer);
+    if (g_trace) {
+        fclose(g_trace);
+        g_trace = NULL;
+    }
+    g_roots = NULL;
+    g_num_roots = 0;
+    for (isize r = 0; r < num_roots; r++) {
+        string_free(roots[r]);
+    }
+    lt_free(roots);
+    g_num_pending = 0;
+    atomic_store(&g_started, false);
 
     pthread_exit(NULL);
 }
@@ -1,17 +1,128 @@
 #ifndef WATCHER_H
 #define WATCHER_H
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#else
+// Only the polling backend exists on other systems. It reports the same masks as
+// inotify does on Linux.
+#define IN_CLOSE_WRITE 0x00000008
+#define IN_MOVED_FROM  0x00000040
+#define IN_MOVED_TO    0x00000080
+#define IN_CREATE      0x00000100
+#define IN_DELETE      0x00000200
+#define IN_Q_OVERFLOW  0x00004000
+#define IN_ISDIR       0x40000000
+#endif
+
+#include <stdio.h>
+
 #include "lt.h"
 
 typedef struct WatcherEvent {
-    String *name;
-    i32     inotify_mask;
+    // Interned by the watcher, and the same pointer for the same path while it exists.
+    // Names of removed paths are freed, but not before the consumer asked for the
+    // next events, so the name is valid until the next drain or peek.
+    const String *name;
+    i32           inotify_mask;
+    // CLOCK_MONOTONIC timestamps of when the watcher read the first of the coalesced
+    // events, and of when the event was queued for the subscription.
+    u64           read_ns;
+    u64           enqueue_ns;
 } WatcherEvent;
 
+// Events meaning a file now has complete new contents: it was closed after being
+// written, or another file was renamed on top of it (atomic saves through a temporary
+// file). Consumers should only read a file after one of these.
+#define WATCHER_FILE_CHANGED (IN_CLOSE_WRITE|IN_MOVED_TO)
+
+#define WATCHER_DEFAULT_DEBOUNCE_MS 50
+#define WATCHER_DEFAULT_POLL_MIN_INTERVAL_MS 50
+#define WATCHER_DEFAULT_POLL_MAX_INTERVAL_MS 2000
+#define WATCHER_DEFAULT_POLL_CPU_BUDGET_PERCENT 5
+// Maximum number of events waiting to be consumed by a subscription, a single drain
+// never returns more.
+#define WATCHER_MAX_EVENTS 16
+#define WATCHER_MAX_SUBSCRIPTIONS 8
+
+// Handle to a subscription, every subscription has its own event queue.
+typedef i32 WatcherSubscription;
+
+typedef enum WatcherBackend {
+    // Kernel notifications, Linux only.
+    WatcherBackend_Inotify,
+    // Periodic scans of the file metadata (mtime, size and inode). Works everywhere,
+    // including mounts where inotify misses changes (bind mounts, FUSE).
+    WatcherBackend_Poll,
+    // Events read back from a trace written with record_path, nothing is watched.
+    WatcherBackend_Replay,
+} WatcherBackend;
+
+typedef struct WatcherStats {
+    // Subscription queue.
+    isize queue_depth;
+    isize queue_high_water;
+    u64   delivered;
+    // Shared by every subscription.
+    u64   coalesced; // Events merged into an already pending event of the same path.
+    u64   dropped;   // Events lost to overflows.
+    u64   overflows; // Times the subscriptions were told to rescan.
+} WatcherStats;
+
+// Configuration passed as the argument of watcher_start. Passing NULL uses the defaults.
+typedef struct WatcherConfig {
+    WatcherBackend backend;
+    // Events on the same path are merged into a single event, which is only delivered
+    // after no new event arrived for this many milliseconds. Zero disables coalescing.
+    i32 debounce_ms;
+    // Directories watched recursively. Event names are the root joined with the path
+    // relative to it. When num_roots is zero the default resources folder is watched.
+    const char *const *roots;
+    isize              num_roots;
+
+    // Polling backend only, zero uses the defaults. The scan interval starts at the
+    // minimum, doubles while nothing changes up to the maximum, and goes back to the
+    // minimum after a change. It is also stretched so scanning uses at most the given
+    // percentage of a core.
+    i32 poll_min_interval_ms;
+    i32 poll_max_interval_ms;
+    i32 poll_cpu_budget_percent;
+
+    // Every event seen by the backend is appended to this trace, before being filtered
+    // or coalesced. With record_contents the new contents of changed files are saved
+    // too, so a replay can restore them before delivering the event.
+    const char *record_path;
+    bool        record_contents;
+    // Replay backend only. Paths of the trace are joined with the configured roots, so
+    // a trace can be replayed on a copy of the resources. The original timing is
+    // divided by replay_speed, zero keeps it and a negative speed does not wait at all.
+    const char *replay_path;
+    f32         replay_speed;
+} WatcherConfig;
+
 void         *watcher_start(void *arg);
 void          watcher_stop();
-WatcherEvent *watcher_peek_event();
-void          watcher_event_peeked();
+
+// Subscriptions and ignore rules have to be registered before the watcher thread is
+// started. Globs containing a `/` match the path relative to its root, the others
+// match the file name. `*` and `?` do not cross directories, `**` does.
+// Returns -1 if the subscription could not be added.
+WatcherSubscription watcher_subscribe(const char *const *globs, isize num_globs);
+// Paths matching an ignore rule are never delivered to any subscription.
+void          watcher_ignore(const char *glob);
+
+WatcherEvent *watcher_peek_event(WatcherSubscription sub);
+void          watcher_event_peeked(WatcherSubscription sub);
+// Moves up to max pending events into out, and returns how many were moved.
+isize         watcher_drain(WatcherSubscription sub, WatcherEvent *out, isize max);
+// Returns true, and clears the flag, if events were dropped since the last call.
+// Individual events can not be trusted anymore, so everything should be rescanned.
+bool          watcher_take_overflow(WatcherSubscription sub);
+
+// Safe to call from any thread.
+void          watcher_get_stats(WatcherSubscription sub, WatcherStats *stats);
+// Also called by the watcher thread when it stops.
+void          watcher_dump_stats(FILE *fp);
 
 
 #endif // WATCHER_H